@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Multi-layer band mesher (advancing front)
+  -------------------------------------------------------------
+  Given a base polyline (x[i], y[i]), this routine builds a
+  layered band mesh in a single native call:
+
+  - Layer 0 is the base polyline itself.
+  - Layer k is the parallel curve of layer k-1 at distance
+    thick[k-1], built with build_parallel_curve and trimmed of
+    its self-intersections with remove_self_intersections. The
+    offset of a closed layer is closed first (close_offset_curve).
+  - The band between layers k-1 and k is filled with triangles
+    by fill_between.
+
+  All vertices are stored in one shared coordinate buffer,
+  layer after layer. lay[k] is the index of the first vertex of
+  layer k, and lay[nlayers+1] is the total number of vertices.
+  Triangles refer to this shared numbering and are stored band
+  after band.
+
+  build_band_layers_adj also returns the triangle adjacency,
+  built with the bands by fill_between_adj: nbr[3t+k] = 3s+l
+  when edge k of triangle t is edge l of triangle s, -1 on the
+  boundary. The outer curve of band k is the inner curve of band
+  k+1, and both zippers list the edges of that layer in order
+  along it, so the two bands are stitched by pairing their lists
+  edge by edge, with no search. bnd[0..nbnd-1] lists the
+  boundary half-edges 3t+k: the base polyline in order, the two
+  ends of each band in turn, then the last layer in order.
+
+  The output buffers are allocated with malloc and must be
+  released by the caller with free.
+  Returns the number of vertices, or 0 on failure.
+-------------------------------------------------------------*/
+
+/*-------------------------------------------------------------
+  Helper: make sure a buffer can hold at least need elements
+-------------------------------------------------------------*/
+static int grow(void **p, int *cap, int need, size_t size) {
+    if (need <= *cap) return 1;
+    int c = *cap > 0 ? *cap : 64;
+    while (c < need) c *= 2;
+    void *q = realloc(*p, (size_t)c * size);
+    if (!q) return 0;
+    *p = q;
+    *cap = c;
+    return 1;
+}
+
+int build_band_layers_adj(
+    double *x, double *y, int n,     // Base polyline
+    int nlayers, double *thick,      // Layer count and thickness schedule
+    double lmin, double lmax,        // Length thresholds
+    double **xv, double **yv,        // Output: shared vertex buffer
+    int **lay,                       // Output: first vertex of each layer
+    int **tri, int *nt,              // Output: triangles and their number
+    int **nbr,                       // Output: neighbours, or NULL
+    int **bnd, int *nbnd             // Output: boundary half-edges
+) {
+    *xv = NULL; *yv = NULL; *lay = NULL; *tri = NULL; *nt = 0;
+    if (nbr) { *nbr = NULL; *bnd = NULL; *nbnd = 0; }
+    if (n < 2 || nlayers < 1) return 0;
+
+    double *vx = NULL, *vy = NULL;
+    int *idx = NULL, *t = NULL;
+    int *nbv = NULL, *bo = NULL, *bk = NULL, *bp = NULL;
+    int cx = 0, cy = 0, ci = 0, ct = 0;
+    int cn = 0, co = 0, ck = 0, cp = 0, no = 0;
+    int *l = malloc((nlayers + 2) * sizeof(int));
+    if (!l) return 0;
+
+    /* ---- Layer 0: copy of the base polyline ---- */
+    if (!grow((void **)&vx, &cx, n, sizeof(double)) ||
+        !grow((void **)&vy, &cy, n, sizeof(double)) ||
+        !grow((void **)&idx, &ci, n, sizeof(int))) goto fail;
+    memcpy(vx, x, n * sizeof(double));
+    memcpy(vy, y, n * sizeof(double));
+    for (int v = 0; v < n; v++) idx[v] = v;
+    l[0] = 0;
+    l[1] = n;
+
+    int ntri = 0;
+    for (int k = 1; k <= nlayers; k++) {
+        int p0 = l[k-1], np = l[k] - l[k-1];
+        int nmax = 2 * np - 1;       // at most one C and one B per segment
+
+        /* ---- Offset the previous layer into the shared buffer ---- */
+        if (!grow((void **)&vx, &cx, l[k] + nmax, sizeof(double)) ||
+            !grow((void **)&vy, &cy, l[k] + nmax, sizeof(double))) goto fail;
+        int m = build_parallel_curve(vx + p0, vy + p0, np, thick[k-1], lmin, lmax,
+                                     vx + l[k], vy + l[k], nmax, 0);
+        if (m >= 2 && vx[p0] == vx[p0 + np - 1] && vy[p0] == vy[p0 + np - 1])
+            close_offset_curve(vx + l[k], vy + l[k], m);
+        m = remove_self_intersections(vx + l[k], vy + l[k], m);
+        if (m < 2) goto fail;
+        l[k+1] = l[k] + m;
+
+        /* ---- Identity index array shared by all bands ---- */
+        if (!grow((void **)&idx, &ci, l[k+1], sizeof(int))) goto fail;
+        for (int v = l[k]; v < l[k+1]; v++) idx[v] = v;
+
+        /* ---- Fill the band between layer k-1 and layer k ---- */
+        int nb = np + m - 2;
+        if (!grow((void **)&t, &ct, 3 * (ntri + nb), sizeof(int))) goto fail;
+        if (!nbr) {
+            int r = fill_between(vx, vy, idx + l[k], m, idx + p0, np, t + 3 * ntri);
+            if (r != nb) goto fail;
+            ntri += r;
+            continue;
+        }
+
+        /* ---- With the adjacency: bk lists the boundary of this
+           band, bp that of the previous one ---- */
+        if (!grow((void **)&nbv, &cn, 3 * (ntri + nb), sizeof(int)) ||
+            !grow((void **)&bk, &ck, np + m, sizeof(int)) ||
+            !grow((void **)&bo, &co, no + (np - 1) + 2 + (m - 1), sizeof(int))) goto fail;
+        int r = fill_between_adj(vx, vy, idx + l[k], m, idx + p0, np,
+                                 t + 3 * ntri, nbv + 3 * ntri, bk);
+        if (r != nb) goto fail;
+
+        // Band-local half-edges to the shared numbering
+        int *e = nbv + 3 * ntri;
+        for (int q = 0; q < 3 * r; q++) if (e[q] >= 0) e[q] += 3 * ntri;
+        for (int q = 0; q < np + m; q++) bk[q] += 3 * ntri;
+
+        // Layer k-1: the outer curve (ia) of the previous band
+        // against the inner curve (ib) of this one, edge by edge
+        if (k == 1) {
+            for (int j = 0; j < np - 1; j++) bo[no++] = bk[m - 1 + j];
+        } else {
+            for (int j = 0; j < np - 1; j++) {
+                nbv[bp[j]] = bk[m - 1 + j];
+                nbv[bk[m - 1 + j]] = bp[j];
+            }
+        }
+        bo[no++] = bk[np + m - 2];
+        bo[no++] = bk[np + m - 1];
+        ntri += r;
+
+        int *sw = bp; bp = bk; bk = sw;
+        int cs = cp; cp = ck; ck = cs;
+    }
+
+    if (nbr) {
+        // The last layer, outer curve of the last band
+        int m = l[nlayers+1] - l[nlayers];
+        for (int i = 0; i < m - 1; i++) bo[no++] = bp[i];
+        free(bk); free(bp);
+        *nbr = nbv; *bnd = bo; *nbnd = no;
+    }
+    free(idx);
+    *xv = vx; *yv = vy; *lay = l;
+    *tri = t; *nt = ntri;
+    return l[nlayers+1];
+
+fail:
+    free(vx); free(vy); free(idx); free(t); free(l);
+    free(nbv); free(bo); free(bk); free(bp);
+    return 0;
+}
+
+int build_band_layers(
+    double *x, double *y, int n,     // Base polyline
+    int nlayers, double *thick,      // Layer count and thickness schedule
+    double lmin, double lmax,        // Length thresholds
+    double **xv, double **yv,        // Output: shared vertex buffer
+    int **lay,                       // Output: first vertex of each layer
+    int **tri, int *nt               // Output: triangles and their number
+) {
+    return build_band_layers_adj(x, y, n, nlayers, thick, lmin, lmax,
+                                 xv, yv, lay, tri, nt, NULL, NULL, NULL);
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the layered band mesher
+  Inputs (D*):
+    x, y       : double arrays with the base polyline
+    nlayers    : integer, number of layers
+    thick      : double array with the thickness of each layer
+                 (a single value is used for all the layers)
+    lmin, lmax : double scalars, length thresholds
+  Returns: D list with the vertex coordinates xv, yv, the
+  triangles tri (3 indices per triangle) and the first vertex
+  of each layer lay, or DCreaNulo() on error.
+  _band_layers_adj6 appends to the list the neighbours nbr (3
+  half-edges per triangle) and the boundary half-edges bnd.
+-------------------------------------------------------------*/
+static D *band_layers_d(int adj, D *x, D *y, D *nlayers,
+                        D *thick, D *lmin, D *lmax) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(nlayers);
+        DLibera(thick);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        nlayers->t != D_TIPO_INT || thick->t != D_TIPO_DOUBLE ||
+        lmin->t != D_TIPO_DOUBLE || lmax->t != D_TIPO_DOUBLE) {
+        DError(adj ? "band_layers_adj : bad argument type" : "band_layers : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(nlayers);
+        DLibera(thick);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    int nl = nlayers->n == 1 ? nlayers->p.i[0] : 0;
+    if (x->n != y->n || nlayers->n != 1 || nl < 1 ||
+        (thick->n != 1 && thick->n != nl) ||
+        lmin->n != 1 || lmax->n != 1) {
+        DError(adj ? "band_layers_adj : bad argument size" : "band_layers : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(nlayers);
+        DLibera(thick);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Expand a single thickness to the whole schedule
+    double *th = malloc((size_t)nl * sizeof(double));
+    if (!th) {
+        DError(adj ? "band_layers_adj : out of memory" : "band_layers : out of memory");
+        DLibera(x);
+        DLibera(y);
+        DLibera(nlayers);
+        DLibera(thick);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+    for (int k = 0; k < nl; k++)
+        th[k] = thick->n == 1 ? thick->p.d[0] : thick->p.d[k];
+
+    double *xv, *yv;
+    int *lay, *tri, nt, *nbr, *bnd, nbnd;
+    int nv = build_band_layers_adj(x->p.d, y->p.d, x->n, nl, th,
+                                   lmin->p.d[0], lmax->p.d[0],
+                                   &xv, &yv, &lay, &tri, &nt,
+                                   adj ? &nbr : NULL, &bnd, &nbnd);
+    free(th);
+
+    D *output;
+    if (nv > 0) {
+        D *dx = DCreaDouble(nv);
+        D *dy = DCreaDouble(nv);
+        D *dt = DCreaInt(3 * nt);
+        D *dl = DCreaInt(nl + 2);
+        memcpy(dx->p.d, xv, nv * sizeof(double));
+        memcpy(dy->p.d, yv, nv * sizeof(double));
+        memcpy(dt->p.i, tri, 3 * nt * sizeof(int));
+        memcpy(dl->p.i, lay, (nl + 2) * sizeof(int));
+
+        output = DCreaLista();
+        DInserta(output, dx);
+        DInserta(output, dy);
+        DInserta(output, dt);
+        DInserta(output, dl);
+        if (adj) {
+            D *dn = DCreaInt(3 * nt);
+            D *db = DCreaInt(nbnd);
+            memcpy(dn->p.i, nbr, 3 * nt * sizeof(int));
+            memcpy(db->p.i, bnd, nbnd * sizeof(int));
+            DInserta(output, dn);
+            DInserta(output, db);
+            free(nbr); free(bnd);
+        }
+        free(xv); free(yv); free(tri); free(lay);
+    } else {
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(nlayers);
+    DLibera(thick);
+    DLibera(lmin);
+    DLibera(lmax);
+
+    return output;
+}
+
+D *_band_layers6(D *x, D *y, D *nlayers, D *thick, D *lmin, D *lmax) {
+    return band_layers_d(0, x, y, nlayers, thick, lmin, lmax);
+}
+
+D *_band_layers_adj6(D *x, D *y, D *nlayers, D *thick, D *lmin, D *lmax) {
+    return band_layers_d(1, x, y, nlayers, thick, lmin, lmax);
+}
+
+#endif
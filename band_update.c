@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grid2d.h"
+#include "predicates.h"
+#include "offset_engine.h"
+
+/*-------------------------------------------------------------
+  Incremental band update
+  -------------------------------------------------------------
+  A BandState keeps one band (a base polyline, its left offset
+  at distance h and the triangles between them) in a layout
+  where a local edit only touches local entries:
+
+  - Every offset point has a fixed slot, given by the base
+    segment that emitted it: the first point is vertex n, and
+    segment i owns vertex n + 1 + 2i (its inserted point C) and
+    n + 2 + 2i (its point B). Vertices live in one buffer, base
+    curve first (0 .. n-1), then the 2n - 1 offset slots; nc[i]
+    says how many points segment i emitted, and the slots of the
+    points it did not emit are simply not referenced.
+  - Every triangle has a fixed slot too. The zipper emits one
+    triangle per step and each step advances one of the two
+    curves, so a triangle is known by the vertex it advances
+    to: slot j - 1 for base vertex j, slot v - 2 for offset
+    vertex v. Empty slots hold -1.
+  - la[i] is the offset vertex A before segment i, and zb[j] the
+    offset vertex where the zip path reaches base vertex j: the
+    edge (zb[j], j) is in the band and the triangles before it
+    only use vertices up to those two.
+
+  update_band_state takes ranges [v0, v1] of moved vertices and,
+  for each of them:
+
+  1. Re-offsets from segment v0 - 2, the first one whose point B
+     depends on a moved vertex, starting from the vertex A
+     before it. A segment only reads three base points and A, so
+     past v1 the new points are kept up to the first segment
+     whose A is again the one of the previous result (same slot,
+     same position): from there on the old points are still
+     right. This is usually the first segment after v1; a fold
+     can hold A longer, and the segments are then offset in
+     chunks of doubling length until A is back in step.
+  2. Picks two anchors (zb[j], j) on the old zip path, before
+     and after the changed points, and zips only the sub-band
+     between them (fill_between_range on a local copy).
+  3. Writes the new points and triangles into their slots.
+
+  Nothing outside the window is read or moved, so the cost of
+  an update follows the size of the edit, not the length of the
+  curve. The result is a valid band, the same as a rebuild up
+  to the end anchors of the windows, where the zip path is kept
+  instead of being chosen again.
+
+  band_state_triangles lists the triangles in zip order for the
+  drivers that need a plain triangle array.
+
+  The offset is the one of build_parallel_curve (lmin/lmax
+  filter included) without remove_self_intersections, whose
+  loops can span the whole curve. The number of base vertices
+  is fixed; inserting or removing vertices needs a rebuild.
+-------------------------------------------------------------*/
+
+#define UPDATE_CHUNK 32    // segments offset past v1 before the first check
+
+/* Slots of the offset points of segment i */
+#define SLOT_C(n, i) ((n) + 1 + 2 * (i))
+#define SLOT_B(n, i) ((n) + 2 + 2 * (i))
+/* Segment owning offset slot v > n */
+#define SLOT_SEG(n, v) (((v) - (n) - 1) / 2)
+
+/*-------------------------------------------------------------
+  Offset loop: direct input, buffer output, lmin/lmax filter,
+  resumed on a range of segments
+-------------------------------------------------------------*/
+#define OE_NAME resume_engine
+#define OE_INPUT OE_DIRECT
+#define OE_SINK OE_BUFFER
+#define OE_FILTER 1
+#define OE_RESUME 1
+#include "offset_engine.h"
+
+/*-------------------------------------------------------------
+  Helper: append to ids[] the offset points emitted by segments
+  s0 .. s1-1 whose slot lies in [from, to]; returns the new count
+-------------------------------------------------------------*/
+static int list_slots(const BandState *s, int s0, int s1, int from, int to,
+                      int *ids, int k)
+{
+    int n = s->n;
+    for (int c = s0; c < s1; c++) {
+        if (s->nc[c] == 2 && SLOT_C(n, c) >= from && SLOT_C(n, c) <= to)
+            ids[k++] = SLOT_C(n, c);
+        if (s->nc[c] >= 1 && SLOT_B(n, c) >= from && SLOT_B(n, c) <= to)
+            ids[k++] = SLOT_B(n, c);
+    }
+    return k;
+}
+
+/*-------------------------------------------------------------
+  Redo the band around the moved vertices v0 .. v1
+  Returns 1, or 0 on failure (state unchanged)
+-------------------------------------------------------------*/
+static int update_range(BandState *s, Grid2DWork *w, double *x, double *y, int v0, int v1) {
+    int n = s->n;
+    double *xv = s->xv, *yv = s->yv;
+
+    /* ---- Move the vertices, keeping the old ones for a failure ---- */
+    int nv = v1 - v0 + 1;
+    double *sx = grid2d_work_alloc(w, 2 * nv * sizeof(double));
+    if (!sx) return 0;
+    memcpy(sx, xv + v0, nv * sizeof(double));
+    memcpy(sx + nv, yv + v0, nv * sizeof(double));
+    memcpy(xv + v0, x + v0, nv * sizeof(double));
+    memcpy(yv + v0, y + v0, nv * sizeof(double));
+
+    /* ---- 1. Re-offset from segment i0 until back in step ---- */
+    int i0 = v0 > 2 ? v0 - 2 : 0;
+    int e = v1 + 1 < n - 1 ? v1 + 1 : n - 1;    // first segment past the edit
+    int aid = i0 > 0 ? s->la[i0] : -1;        // vertex A before segment i0
+    double a[2] = { 0.0, 0.0 };
+    if (i0 > 0) {
+        a[0] = xv[aid];
+        a[1] = yv[aid];
+    }
+
+    int q = 0, cap = 0;                       // new points, room for them
+    double *px = NULL, *py = NULL;
+    int *pid = NULL;                          // slots of the new points
+    int *rm = NULL;                           // rm[i - i0]: new points before segment i
+    int i = i0, stop = -1;
+    for (int len = UPDATE_CHUNK; stop < 0; len *= 2) {
+        int i2 = e + len < n - 1 ? e + len : n - 1;
+        int need = 2 * (i2 - i0) + 1;
+        double *nx = grid2d_work_alloc(w, need * sizeof(double));
+        double *ny = grid2d_work_alloc(w, need * sizeof(double));
+        int *ni = grid2d_work_alloc(w, need * sizeof(int));
+        int *nr = grid2d_work_alloc(w, (i2 - i0 + 1) * sizeof(int));
+        if (!nx || !ny || !ni || !nr) goto fail;
+        if (q > 0) {
+            memcpy(nx, px, q * sizeof(double));
+            memcpy(ny, py, q * sizeof(double));
+            memcpy(ni, pid, q * sizeof(int));
+        }
+        if (rm) memcpy(nr, rm, (i - i0 + 1) * sizeof(int));
+        px = nx; py = ny; pid = ni; rm = nr; cap = need;
+
+        int k = resume_engine(xv, yv, n, s->h, s->lmin, s->lmax, i, i2, a,
+                              rm + (i - i0), px + q, py + q, cap - q);
+        if (i == 0 && k == 0) goto fail;      // zero length first segment
+        for (int c = i; c <= i2; c++) rm[c - i0] += q;
+        if (i == 0) pid[0] = n;
+        for (int c = i; c < i2; c++) {
+            int r = rm[c - i0], cnt = rm[c + 1 - i0] - r;
+            if (cnt == 2) pid[r++] = SLOT_C(n, c);
+            if (cnt >= 1) pid[r] = SLOT_B(n, c);
+        }
+        q += k;
+
+        /* First segment from e on whose A is the old one */
+        for (int c = i > e ? i : e; c < i2 && stop < 0; c++) {
+            int r = rm[c - i0];
+            if (r == 0 ? aid == s->la[c]
+                       : pid[r-1] == s->la[c] && px[r-1] == xv[pid[r-1]] && py[r-1] == yv[pid[r-1]])
+                stop = c;
+        }
+        if (stop < 0 && i2 == n - 1) stop = n - 1;
+        i = i2;
+    }
+    q = rm[stop - i0];
+
+    /* ---- 2. Anchors on the old zip path ----
+       The sub-band must end on the old path, so its closing strips
+       are forced; if they come out inverted, the anchors are moved
+       further out and the sub-band is zipped again */
+    int j0, j1, first, last, na, nb, ntl, *ids, *lt;
+    for (int extra = 0; ; extra = extra ? 4 * extra : 4) {
+        j0 = 0;
+        j1 = n - 1;
+        if (i0 > 0) {
+            j0 = v0 - 1;
+            while (j0 > 0 && s->zb[j0] > aid) j0--;
+            j0 = j0 > extra ? j0 - extra : 0;
+        }
+        if (stop < n - 1) {
+            j1 = e;
+            while (j1 < n - 1 && s->zb[j1] < s->la[stop]) j1++;
+            j1 = j1 + extra < n - 1 ? j1 + extra : n - 1;
+        }
+        first = s->zb[j0];
+        last = j1 < n - 1 ? s->zb[j1] : 3 * n - 2;
+        int wide = j0 == 0 && j1 == n - 1;    // whole band, nothing to widen
+
+        /* Offset vertices of the sub-band, in order */
+        int sa = first > n ? SLOT_SEG(n, first) : 0;
+        int sb = j1 < n - 1 ? SLOT_SEG(n, last) + 1 : n - 1;
+        if (sb < stop) sb = stop;
+        ids = grid2d_work_alloc(w, (1 + 2 * (i0 - sa) + q + 2 * (sb - stop)) * sizeof(int));
+        if (!ids) goto fail;
+        na = 0;
+        if (i0 > 0) {
+            if (first == n) ids[na++] = n;
+            na = list_slots(s, sa, i0, first, aid, ids, na);
+        }
+        int nk = na;                          // kept points before the new ones
+        memcpy(ids + na, pid, q * sizeof(int));
+        na += q;
+        na = list_slots(s, stop, sb, 0, last, ids, na);
+
+        /* Local copy of the sub-band: base j0..j1, then offset */
+        nb = j1 - j0 + 1;
+        ntl = na + nb - 2;
+        double *lx = grid2d_work_alloc(w, (nb + na) * sizeof(double));
+        double *ly = grid2d_work_alloc(w, (nb + na) * sizeof(double));
+        lt = grid2d_work_alloc(w, 3 * ntl * sizeof(int));
+        if (!lx || !ly || !lt) goto fail;
+        memcpy(lx, xv + j0, nb * sizeof(double));
+        memcpy(ly, yv + j0, nb * sizeof(double));
+        for (int k = 0; k < na; k++) {
+            int r = k - nk;
+            lx[nb + k] = r >= 0 && r < q ? px[r] : xv[ids[k]];
+            ly[nb + k] = r >= 0 && r < q ? py[r] : yv[ids[k]];
+        }
+
+        if (fill_between_range(lx, ly, nb, 1, na, 0, 1, nb, lt) != ntl) {
+            if (wide) goto fail;
+            continue;
+        }
+        if (wide) break;
+        int inv = 0;
+        for (int k = 0; k < ntl && !inv; k++) {
+            int *t = lt + 3 * k;
+            inv = orient2d(lx[t[0]], ly[t[0]], lx[t[1]], ly[t[1]], lx[t[2]], ly[t[2]]) < 0.0;
+        }
+        if (!inv) break;
+    }
+
+    /* ---- 3. Points, segment records and triangles into their slots ---- */
+    int old = i0 == 0;                        // old points replaced
+    for (int c = i0; c < stop; c++) old += s->nc[c];
+    for (int r = 0; r < q; r++) {
+        xv[pid[r]] = px[r];
+        yv[pid[r]] = py[r];
+    }
+    for (int c = i0; c <= stop; c++) {
+        int r = rm[c - i0];
+        s->la[c] = r > 0 ? pid[r-1] : aid;
+        if (c < stop) s->nc[c] = rm[c + 1 - i0] - r;
+    }
+
+    for (int v = first + 1; v <= last; v++) s->tri[3 * (v - 2)] = -1;
+    int av = first, j = j0;                   // zip path
+    for (int k = 0; k < ntl; k++) {
+        int *t = lt + 3 * k, g[3];
+        for (int c = 0; c < 3; c++) g[c] = t[c] < nb ? j0 + t[c] : ids[t[c] - nb];
+        int slot = g[2] < n ? g[2] - 1 : g[2] - 2;
+        memcpy(s->tri + 3 * slot, g, sizeof(g));
+        if (g[2] < n) s->zb[++j] = av;
+        else av = g[2];
+    }
+
+    s->m += q - old;
+    s->nt = (n - 1) + (s->m - 1);
+    return 1;
+
+fail:
+    memcpy(xv + v0, sx, nv * sizeof(double));
+    memcpy(yv + v0, sx + nv, nv * sizeof(double));
+    return 0;
+}
+
+/*-------------------------------------------------------------
+  Build the band from scratch
+  Scratch memory is taken from w.
+  Returns the number of triangles, or 0 on failure
+-------------------------------------------------------------*/
+int build_band_state(
+    BandState *s, Grid2DWork *w,
+    double *x, double *y, int n,     // Base polyline
+    double h,                        // Offset distance
+    double lmin, double lmax         // Length thresholds
+) {
+    free_band_state(s);
+    if (n < 2) return 0;
+
+    s->xv = malloc((3 * (size_t)n - 1) * sizeof(double));
+    s->yv = malloc((3 * (size_t)n - 1) * sizeof(double));
+    s->nc = malloc(n - 1);
+    s->la = malloc(n * sizeof(int));
+    s->zb = malloc(n * sizeof(int));
+    s->tri = malloc(9 * ((size_t)n - 1) * sizeof(int));
+    if (!s->xv || !s->yv || !s->nc || !s->la || !s->zb || !s->tri) {
+        free_band_state(s);
+        return 0;
+    }
+
+    /* An empty band, with the first point counted, updated as a
+       whole: every slot is written by update_range */
+    memcpy(s->xv, x, n * sizeof(double));
+    memcpy(s->yv, y, n * sizeof(double));
+    memset(s->nc, 0, n - 1);
+    for (int i = 0; i < n; i++) s->la[i] = -1;
+    memset(s->tri, 0xff, 9 * ((size_t)n - 1) * sizeof(int));
+    s->zb[0] = n;
+    s->n = n;
+    s->m = 1;
+    s->h = h;
+    s->lmin = lmin;
+    s->lmax = lmax;
+
+    grid2d_work_reset(w);
+    if (!update_range(s, w, x, y, 0, n - 1)) {
+        free_band_state(s);
+        return 0;
+    }
+    return s->nt;
+}
+
+/*-------------------------------------------------------------
+  Update the band after the base vertices in the ranges
+  [dirty[2k], dirty[2k+1]] (k < ndirty) have moved to their new
+  positions in x, y (n points, as given to build_band_state).
+  Scratch memory is taken from w.
+  Returns the number of triangles, or 0 on failure; the ranges
+  before the failing one are applied, and a rebuild with
+  build_band_state gives a valid band again.
+-------------------------------------------------------------*/
+int update_band_state(
+    BandState *s, Grid2DWork *w,
+    double *x, double *y,            // Moved base polyline
+    const int *dirty, int ndirty     // Ranges of moved vertices
+) {
+    if (s->nt <= 0) return 0;
+    for (int k = 0; k < ndirty; k++) {
+        int v0 = dirty[2*k], v1 = dirty[2*k+1];
+        if (v0 < 0) v0 = 0;
+        if (v1 > s->n - 1) v1 = s->n - 1;
+        if (v0 > v1) continue;
+        grid2d_work_reset(w);
+        if (!update_range(s, w, x, y, v0, v1)) return 0;
+    }
+    return s->nt;
+}
+
+/*-------------------------------------------------------------
+  Copy the triangles of the band, in zip order, to tri
+  (3 * s->nt entries); returns their number
+-------------------------------------------------------------*/
+int band_state_triangles(const BandState *s, int *tri) {
+    int n = s->n, av = n, j = 0;
+    for (int k = 0; k < s->nt; k++) {
+        const int *t = s->tri + 3 * j;
+        if (j == n - 1 || t[0] != av || t[1] != j) {
+            /* Not the base step: the next filled offset slot */
+            int v = av + 1;
+            while (s->tri[3 * (v - 2)] < 0) v++;
+            t = s->tri + 3 * (v - 2);
+            av = v;
+        } else {
+            j++;
+        }
+        memcpy(tri + 3 * k, t, 3 * sizeof(int));
+    }
+    return s->nt;
+}
+
+/*-------------------------------------------------------------
+  Free the buffers of a band state and leave it empty
+-------------------------------------------------------------*/
+void free_band_state(BandState *s) {
+    free(s->xv);
+    free(s->yv);
+    free(s->nc);
+    free(s->la);
+    free(s->zb);
+    free(s->tri);
+    *s = (BandState)BAND_STATE_INIT;
+}
@@ -0,0 +1,777 @@
+/*-------------------------------------------------------------
+  Benchmark of the offset and band-triangulation kernels
+  -------------------------------------------------------------
+  Builds synthetic curves from 10 points up to a maximum size
+  (10^6 by default) and times each kernel on them:
+
+    parallel      build_parallel_curve          (offset1.c)
+    offset_arr    offset_curve, array output    (offset_test.c)
+    offset_ind    offset_curve, indexed input   (test_triangula1.c)
+    multi         build_parallel_multi, 8
+                  geometric layers in one pass  (offset1.c)
+    multi_loop    the same 8 layers, one
+                  build_parallel_curve each     (offset1.c)
+    clean         remove_self_intersections     (offset_clean.c)
+    fill          fill_between                  (triangulate.c)
+    fill_range    fill_between_range            (triangulate.c)
+    fill_par      fill_between_par              (triangulate.c)
+    fill_adj      fill_between_adj, triangles
+                  and adjacency in one pass     (triangulate.c)
+    loc_build     build_locator on that band,
+                  with its adjacency            (locate.c)
+    locate        locate_points, n points at
+                  random in the band            (locate.c)
+    fill_stream   fill_between_stream           (triangulate.c)
+    mesh_write    the band streamed to a mesh
+                  file through mesh_writer_sink (meshfile.c)
+    mesh_open     mesh_file_open of that file   (meshfile.c)
+    parallel_f    build_parallel_curve_f        (offset1.c)
+    fill_f        fill_between_range_f, on the
+                  band stored as float          (triangulate.c)
+    quad_band     build_quad_band, offset and
+                  quad band in one pass         (quad_band.c)
+    banda_area    triangula_banda_area          (test_triangula.c)
+    remesh_ws     offset, clean and fill chained
+                  through one Grid2DWork        (workspace.c)
+    rcm           reorder_mesh, reverse
+                  Cuthill-McKee on the band     (reorder.c)
+    hilbert       reorder_mesh, Hilbert sort    (reorder.c)
+    flip          improve_quality, Delaunay
+                  flips on the zipped band      (quality.c)
+    sdf           curve_distance_field on a
+                  grid of about 4n nodes        (distance.c)
+    contour       distance_contour, level h of
+                  that field                    (distance.c)
+    band_build    build_band_state              (band_update.c)
+    band_update   update_band_state, 3 vertices
+                  moved at mid curve            (band_update.c)
+
+  Curves:
+    sine      smooth sine wave
+    spiral    Archimedean spiral, 5 turns
+    zigzag    sharp zigzag, one corner per point
+    coast     noisy coastline (sum of sines plus random walk)
+
+  For every kernel, curve and size it reports the time per input
+  vertex and the bytes allocated per vertex (output buffers given
+  to the kernel plus any malloc inside it). Reading a column of
+  ns/vertex down the sizes gives the scaling curve.
+
+  The demo files are compiled into this program with their main()
+  renamed, so the kernels timed are exactly the ones in the tree.
+  triangula_banda_area prints two lines per step; its stdout is
+  sent to /dev/null while it runs, so that column includes stdio.
+  The bands are zipped between each curve and its offset; a band
+  the zipper rejects is reported as failed. remesh_ws reuses one
+  workspace across its runs, as a remeshing loop would, after one
+  warm-up call; its B/vertex is what is still allocated per call
+  in steady state. band_update times one local edit of a band
+  kept in a BandState; its ns/vertex is still divided by the
+  curve length, so it shrinks as 1/n when the update is local.
+  flip starts every run from a copy of the zipped band, and the
+  copy is included in its time. locate reuses one locator of the
+  band; its B/vertex counts the answers (triangle and barycentric
+  coordinates) as output. mesh_write goes through the page cache
+  of the temporary directory, and mesh_open maps the file and
+  reads its table only, so its time does not grow with n.
+
+  A few regression checks of cases the synthetic curves do not
+  reach (see bench_checks) run before the timings; the benchmark
+  stops with status 1 if one of them fails.
+
+  Build and run:
+    gcc -O2 -march=native -fopenmp -DGRID2D_NO_D -o bench bench.c -lm
+    ./bench [max_points] [-csv]
+-------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* ---- Count the bytes allocated inside the kernels ---- */
+static size_t bench_bytes = 0;
+
+static void *bench_malloc(size_t n) { bench_bytes += n; return malloc(n); }
+
+#define malloc bench_malloc
+
+#include "offset1.c"
+#include "triangulate.c"
+#include "offset_clean.c"
+#include "workspace.c"
+#include "band_update.c"
+#include "quad_band.c"
+#include "reorder.c"
+#include "quality.c"
+#include "distance.c"
+#include "locate.c"
+#include "meshfile.c"
+#include "offset_batch.c"
+#include "band_layers.c"
+
+#define main offset_test_main
+#define offset_curve offset_curve_arr
+#define offset_motor offset_motor_arr
+#include "offset_test.c"
+#undef offset_motor
+#undef offset_curve
+#undef main
+
+#define main test_triangula1_main
+#define offset_curve offset_curve_ind
+#define offset_motor offset_motor_ind
+#include "test_triangula1.c"
+#undef offset_motor
+#undef offset_curve
+#undef main
+
+#define main test_triangula_main
+#include "test_triangula.c"
+#undef main
+
+#undef malloc
+
+/*-------------------------------------------------------------
+  Helper: monotonic clock in seconds
+-------------------------------------------------------------*/
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+/*-------------------------------------------------------------
+  Synthetic curves, all about 100 units long
+-------------------------------------------------------------*/
+enum { SINE, SPIRAL, ZIGZAG, COAST, NCURVES };
+static const char *curve_name[NCURVES] = { "sine", "spiral", "zigzag", "coast" };
+
+static void make_curve(int kind, int n, double *x, double *y) {
+    unsigned s = 12345;
+    double walk = 0;
+    for (int i = 0; i < n; i++) {
+        double f = (double)i / (n - 1);
+        switch (kind) {
+        case SINE:
+            x[i] = 100.0 * f;
+            y[i] = 3.0 * sin(0.5 * x[i]);
+            break;
+        case SPIRAL: {
+            double th = 10.0 * M_PI * f;
+            x[i] = (1.0 + 0.3 * th) * cos(th);
+            y[i] = (1.0 + 0.3 * th) * sin(th);
+            break;
+        }
+        case ZIGZAG:
+            x[i] = 100.0 * f;
+            y[i] = (i & 1) ? 200.0 / n : 0.0;
+            break;
+        case COAST:
+            s = s * 1103515245u + 12345u;
+            walk += ((s >> 16) / 32768.0 - 1.0) * 10.0 / n;
+            x[i] = 100.0 * f;
+            y[i] = 2.0 * sin(0.3 * x[i]) + 0.5 * sin(2.1 * x[i]) + walk;
+            break;
+        }
+    }
+}
+
+/*-------------------------------------------------------------
+  One benchmark case: base curve, its offset and the band indices
+-------------------------------------------------------------*/
+typedef struct {
+    int n, m;               // points of the base curve and its offset
+    double *x, *y;          // base curve followed by its offset
+    double *x0, *y0;        // offset output buffer
+    int *ia, *ib, *ind;     // band indices and 1-based curve indices
+    int *tri;               // triangle output buffer
+    double h;
+} Case;
+
+static int emit_csv = 0;
+
+static void report(const char *kernel, int curve, int n, int reps, double t, size_t bytes) {
+    double ns = t / reps / n * 1e9;
+    double bpv = (double)bytes / n;
+    if (emit_csv)
+        printf("%s,%s,%d,%.3f,%.1f\n", kernel, curve_name[curve], n, ns, bpv);
+    else
+        printf("%-11s %-7s %9d %10.2f %10.1f\n", kernel, curve_name[curve], n, ns, bpv);
+    fflush(stdout);
+}
+
+/* Sink of fill_between_stream: folds the triangles into a checksum,
+   standing for a writer or an assembler */
+#define STREAM_BLOCK 1024
+
+static int checksum_sink(void *ctx, const int *tri, int nt) {
+    unsigned *sum = ctx;
+    for (int k = 0; k < 3 * nt; k++) *sum = *sum * 31u + (unsigned)tri[k];
+    return 1;
+}
+
+/* Repeat a call until at least 0.2 s and 3 runs, return the time */
+#define TIME_IT(reps, t, call)                                  \
+    do {                                                        \
+        double t0_ = now();                                     \
+        reps = 0;                                               \
+        do { call; reps++; } while (reps < 3 || now() - t0_ < 0.2); \
+        t = now() - t0_;                                        \
+    } while (0)
+
+static void bench_case(Case *c, int curve) {
+    int n = c->n, reps, r = 0;
+    double t;
+    size_t out = 2 * (2 * (size_t)n - 1) * sizeof(double);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = build_parallel_curve(c->x, c->y, n, c->h, 0.0, 1e30,
+                                              c->x0, c->y0, 2 * n - 1, 0));
+    report("parallel", curve, n, reps, t, out + bench_bytes / reps);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = offset_curve_arr(c->x, c->y, n, c->h, c->x0, c->y0, 2 * n - 1));
+    report("offset_arr", curve, n, reps, t, out + bench_bytes / reps);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, offset_curve_ind(c->x, c->y, c->ind, n, c->h));
+    report("offset_ind", curve, n, reps, t, bench_bytes / reps);
+
+    /* Boundary layers: one pass against one call per layer */
+    enum { NLAY = 8 };
+    double hl[NLAY];
+    int ml[NLAY];
+    parallel_multi_schedule(c->h / 8, 1.2, NLAY, hl);
+    size_t mout = 2 * NLAY * (2 * (size_t)n - 1) * sizeof(double);
+    double *mx = malloc(mout / 2), *my = malloc(mout / 2);
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = build_parallel_multi(c->x, c->y, n, NLAY, hl, 0.0, 1e30, mx, my, ml));
+    report("multi", curve, n, reps, t, mout + bench_bytes / reps);
+    bench_bytes = 0;
+    TIME_IT(reps, t, for (int k = 0; k < NLAY; k++)
+                         r = build_parallel_curve(c->x, c->y, n, hl[k], 0.0, 1e30,
+                                                  mx + k * (2 * n - 1), my + k * (2 * n - 1),
+                                                  2 * n - 1, 0));
+    report("multi_loop", curve, n, reps, t, mout + bench_bytes / reps);
+    free(mx);
+    free(my);
+
+    /* The bands use the left offset of build_parallel_curve,
+       trimmed of its self-intersections */
+    int m = build_parallel_curve(c->x, c->y, n, c->h, 0.0, 1e30, c->x0, c->y0, 2 * n - 1, 0);
+    bench_bytes = 0;
+    TIME_IT(reps, t, memcpy(c->x + n, c->x0, m * sizeof(double));
+                     memcpy(c->y + n, c->y0, m * sizeof(double));
+                     r = remove_self_intersections(c->x + n, c->y + n, m));
+    report("clean", curve, n, reps, t, bench_bytes / reps);
+    m = r;
+    for (int k = 0; k < m; k++) c->ia[k] = n + k;
+    size_t tout = 3 * (size_t)(n + m) * sizeof(int);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between(c->x, c->y, c->ia, m, c->ib, n, c->tri));
+    if (r == n + m - 2) report("fill", curve, n, reps, t, tout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill", curve_name[curve], n);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between_range(c->x, c->y, n, 1, m, 0, 1, n, c->tri));
+    if (r == n + m - 2) report("fill_range", curve, n, reps, t, tout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill_range", curve_name[curve], n);
+
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between_par(c->x, c->y, c->ia, m, c->ib, n, c->tri, (n + m) / FILL_CHUNK));
+    if (r == n + m - 2) report("fill_par", curve, n, reps, t, tout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill_par", curve_name[curve], n);
+
+    int *nbr = malloc(3 * (size_t)(n + m) * sizeof(int)), *bnd = malloc((n + m) * sizeof(int));
+    size_t aout = tout + 4 * (size_t)(n + m) * sizeof(int);
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between_adj(c->x, c->y, c->ia, m, c->ib, n, c->tri, nbr, bnd));
+    if (r == n + m - 2) report("fill_adj", curve, n, reps, t, aout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill_adj", curve_name[curve], n);
+
+    /* Point location in that band: n points drawn at random in
+       its triangles, in random order */
+    if (r == n + m - 2) {
+        double *qx = malloc(2 * (size_t)n * sizeof(double)), *qy = qx + n;
+        double *qb = malloc(3 * (size_t)n * sizeof(double));
+        int *qt = malloc(n * sizeof(int)), nf = 0;
+        unsigned s = 777;
+        for (int k = 0; k < n; k++) {
+            s = s * 1103515245u + 12345u;
+            const int *v = c->tri + 3 * (int)((s >> 8) % (unsigned)r);
+            s = s * 1103515245u + 12345u;
+            double a = (s >> 8) / 16777216.0;
+            s = s * 1103515245u + 12345u;
+            double b = (s >> 8) / 16777216.0;
+            if (a + b > 1.0) { a = 1.0 - a; b = 1.0 - b; }
+            qx[k] = c->x[v[0]] + a * (c->x[v[1]] - c->x[v[0]]) + b * (c->x[v[2]] - c->x[v[0]]);
+            qy[k] = c->y[v[0]] + a * (c->y[v[1]] - c->y[v[0]]) + b * (c->y[v[2]] - c->y[v[0]]);
+        }
+        Locator loc = LOCATOR_INIT;
+        Grid2DWork lw = GRID2D_WORK_INIT;
+        bench_bytes = 0;
+        TIME_IT(reps, t, nf = build_locator(&loc, &lw, c->x, c->y, c->tri, r, nbr));
+        if (nf) report("loc_build", curve, n, reps, t, bench_bytes / reps);
+        else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "loc_build", curve_name[curve], n);
+        if (nf) {
+            bench_bytes = 0;
+            TIME_IT(reps, t, nf = locate_points(&loc, &lw, qx, qy, n, qt, qb));
+            if (nf == n) report("locate", curve, n, reps, t,
+                                (size_t)n * (sizeof(int) + 3 * sizeof(double)) + bench_bytes / reps);
+            else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "locate", curve_name[curve], n);
+        }
+        free_locator(&loc);
+        grid2d_work_free(&lw);
+        free(qx); free(qb); free(qt);
+    }
+    free(nbr);
+    free(bnd);
+
+    int blk[3 * STREAM_BLOCK];
+    unsigned sum = 0;
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between_stream(c->x, c->y, c->ia, m, c->ib, n,
+                                             blk, STREAM_BLOCK, checksum_sink, &sum));
+    if (r == n + m - 2) report("fill_stream", curve, n, reps, t, sizeof(blk) + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill_stream", curve_name[curve], n);
+
+    /* The band streamed to a mesh file: the two curves, then the
+       triangles block by block through mesh_writer_sink */
+    {
+        const char *path = P_tmpdir "/bench_mesh.g2m";
+        MeshWriter mw;
+        MeshFile mf = MESH_FILE_INIT;
+        int ok = 0;
+        bench_bytes = 0;
+        TIME_IT(reps, t, ok = mesh_writer_open(&mw, path) &&
+                              mesh_write_vertices(&mw, c->x, c->y, n, 0) &&
+                              mesh_write_vertices(&mw, c->x + n, c->y + n, m, 1) &&
+                              fill_between_stream(c->x, c->y, c->ia, m, c->ib, n, blk, STREAM_BLOCK,
+                                                  mesh_writer_sink, &mw) == n + m - 2;
+                         ok = mesh_writer_close(&mw) && ok);
+        if (ok) report("mesh_write", curve, n, reps, t, sizeof(blk) + bench_bytes / reps);
+        else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "mesh_write", curve_name[curve], n);
+        if (ok) {
+            bench_bytes = 0;
+            TIME_IT(reps, t, ok = mesh_file_open(&mf, path) && mf.ntri == n + m - 2;
+                             mesh_file_close(&mf));
+            if (ok) report("mesh_open", curve, n, reps, t, bench_bytes / reps);
+            else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "mesh_open", curve_name[curve], n);
+        }
+        remove(path);
+    }
+
+    /* Single precision: the band rounded to float, followed by
+       room for the offset of parallel_f */
+    float *fx = malloc((n + 4 * (size_t)n) * sizeof(float));
+    float *fy = malloc((n + 4 * (size_t)n) * sizeof(float));
+    for (int k = 0; k < n + m; k++) { fx[k] = (float)c->x[k]; fy[k] = (float)c->y[k]; }
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = build_parallel_curve_f(fx, fy, n, c->h, 0.0, 1e30,
+                                                fx + n + m, fy + n + m, 2 * n - 1, 0));
+    report("parallel_f", curve, n, reps, t, out / 2 + bench_bytes / reps);
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = fill_between_range_f(fx, fy, n, 1, m, 0, 1, n, c->tri));
+    if (r == n + m - 2) report("fill_f", curve, n, reps, t, tout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "fill_f", curve_name[curve], n);
+    free(fx);
+    free(fy);
+
+    /* Quad band: its own vertex buffer, elements in tri */
+    double *qx = malloc((3 * (size_t)n - 1) * sizeof(double));
+    double *qy = malloc((3 * (size_t)n - 1) * sizeof(double));
+    int nq, nqt;
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = build_quad_band(c->x, c->y, n, c->h, 0.0, 1e30, qx, qy,
+                                         c->tri, &nq, c->tri + 4 * (n - 1), &nqt));
+    size_t qout = 2 * (3 * (size_t)n - 1) * sizeof(double) + 7 * (size_t)(n - 1) * sizeof(int);
+    if (r > 0) report("quad_band", curve, n, reps, t, qout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "quad_band", curve_name[curve], n);
+    free(qx);
+    free(qy);
+
+    /* Whole chain through a workspace, warmed up by one call */
+    Grid2DWork w = GRID2D_WORK_INIT;
+    double *wx, *wy;
+    int *wt;
+#define REMESH_WS                                                           \
+    (m = build_parallel_curve_ws(&w, c->x, c->y, n, c->h, 0.0, 1e30, &wx, &wy, 0), \
+     memcpy(c->x + n, wx, m * sizeof(double)),                              \
+     memcpy(c->y + n, wy, m * sizeof(double)),                              \
+     m = remove_self_intersections_ws(&w, c->x + n, c->y + n, m),           \
+     r = fill_between_ws(&w, c->x, c->y, c->ia, m, c->ib, n, &wt))
+    REMESH_WS;
+    grid2d_work_reset(&w);
+    bench_bytes = 0;
+    TIME_IT(reps, t, REMESH_WS);
+#undef REMESH_WS
+    if (r == n + m - 2) report("remesh_ws", curve, n, reps, t, bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "remesh_ws", curve_name[curve], n);
+
+    /* Renumbering of the band just built, on a copy; the runs
+       after the first renumber an already renumbered mesh, which
+       costs the same */
+    if (r == n + m - 2) {
+        static const char *rname[] = { "rcm", "hilbert" };
+        int nv = n + m;
+        double *rx = malloc(nv * sizeof(double)), *ry = malloc(nv * sizeof(double));
+        int *rt = malloc(3 * (size_t)r * sizeof(int));
+        int *vperm = malloc(nv * sizeof(int)), *eperm = malloc(r * sizeof(int));
+        memcpy(rx, c->x, nv * sizeof(double));
+        memcpy(ry, c->y, nv * sizeof(double));
+        memcpy(rt, wt, 3 * (size_t)r * sizeof(int));
+        Grid2DWork rw = GRID2D_WORK_INIT;
+        for (int method = REORDER_RCM; method <= REORDER_HILBERT; method++) {
+            int bw = reorder_mesh(&rw, method, rx, ry, nv, 3, rt, r, vperm, eperm);
+            grid2d_work_reset(&rw);
+            bench_bytes = 0;
+            TIME_IT(reps, t, bw = reorder_mesh(&rw, method, rx, ry, nv, 3, rt, r, vperm, eperm));
+            if (bw >= 0) report(rname[method], curve, n, reps, t, bench_bytes / reps);
+        }
+        grid2d_work_free(&rw);
+        free(rx); free(ry); free(rt); free(vperm); free(eperm);
+    }
+
+    /* Edge flips of the zipped band, from a copy every run */
+    if (r == n + m - 2) {
+        int *ft = malloc(3 * (size_t)r * sizeof(int)), fl = 0;
+        Grid2DWork fw = GRID2D_WORK_INIT;
+        memcpy(ft, wt, 3 * (size_t)r * sizeof(int));
+        improve_quality(&fw, c->x, c->y, ft, r, FLIP_DELAUNAY, NULL, NULL);
+        grid2d_work_reset(&fw);
+        bench_bytes = 0;
+        TIME_IT(reps, t, (memcpy(ft, wt, 3 * (size_t)r * sizeof(int)),
+                          fl = improve_quality(&fw, c->x, c->y, ft, r, FLIP_DELAUNAY, NULL, NULL)));
+        if (fl >= 0) report("flip", curve, n, reps, t, bench_bytes / reps);
+        grid2d_work_free(&fw);
+        free(ft);
+    }
+
+    /* Distance field on a grid of about 4n nodes over the box
+       of the curve grown by 2h, and its level h */
+    {
+        double bx0 = c->x[0], bx1 = c->x[0], by0 = c->y[0], by1 = c->y[0];
+        for (int k = 1; k < n; k++) {
+            bx0 = fmin(bx0, c->x[k]); bx1 = fmax(bx1, c->x[k]);
+            by0 = fmin(by0, c->y[k]); by1 = fmax(by1, c->y[k]);
+        }
+        double g = 2.0 * fabs(c->h);
+        bx0 -= g; bx1 += g; by0 -= g; by1 += g;
+        double gdx = sqrt((bx1 - bx0) * (by1 - by0) / (4.0 * n));
+        int gnx = (int)((bx1 - bx0) / gdx) + 2, gny = (int)((by1 - by0) / gdx) + 2;
+        double *phi = malloc((size_t)gnx * gny * sizeof(double)), *cx, *cy;
+        int *coff, nb = 0, nl = 0;
+        Grid2DWork dw = GRID2D_WORK_INIT;
+        curve_distance_field(&dw, c->x, c->y, n, bx0, by0, gdx, gnx, gny, 3, phi);
+        bench_bytes = 0;
+        TIME_IT(reps, t, nb = curve_distance_field(&dw, c->x, c->y, n, bx0, by0, gdx, gnx, gny, 3, phi));
+        if (nb > 0) report("sdf", curve, n, reps, t, (size_t)gnx * gny * sizeof(double) + bench_bytes / reps);
+        distance_contour(&dw, phi, bx0, by0, gdx, gnx, gny, c->h, &cx, &cy, &coff);
+        bench_bytes = 0;
+        TIME_IT(reps, t, nl = distance_contour(&dw, phi, bx0, by0, gdx, gnx, gny, c->h, &cx, &cy, &coff));
+        if (nl >= 0) report("contour", curve, n, reps, t, bench_bytes / reps);
+        grid2d_work_free(&dw);
+        free(phi);
+    }
+
+    /* Band kept for incremental updates: build, then a small
+       edit at mid curve moved back and forth */
+    BandState bs = BAND_STATE_INIT;
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = build_band_state(&bs, &w, c->x, c->y, n, c->h, 0.0, 1e30));
+    if (r) report("band_build", curve, n, reps, t, bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "band_build", curve_name[curve], n);
+    if (r) {
+        int dirty[2] = { n / 2 - 1, n / 2 + 1 };
+        double y1 = c->y[n / 2], dy = 1e-3 * c->h;
+        int k = 0;
+        bench_bytes = 0;
+        TIME_IT(reps, t, c->y[n / 2] = y1 + ((k++ & 1) ? 0.0 : dy);
+                         r = update_band_state(&bs, &w, c->x, c->y, dirty, 1));
+        c->y[n / 2] = y1;
+        if (r) report("band_update", curve, n, reps, t, bench_bytes / reps);
+        else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "band_update", curve_name[curve], n);
+    }
+    free_band_state(&bs);
+    grid2d_work_free(&w);
+
+    /* triangula_banda_area prints every step: silence stdout */
+    fflush(stdout);
+    int saved = dup(1), null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    bench_bytes = 0;
+    TIME_IT(reps, t, r = triangula_banda_area(c->x, c->y, n, c->ib, c->x + n, c->y + n, m, c->ia, c->tri));
+    fflush(stdout);
+    dup2(saved, 1);
+    close(null);
+    close(saved);
+    if (r) report("banda_area", curve, n, reps, t, tout + bench_bytes / reps);
+    else if (!emit_csv) printf("%-11s %-7s %9d     failed\n", "banda_area", curve_name[curve], n);
+}
+
+/*-------------------------------------------------------------
+  Regression checks of cases the timings do not cover, run once
+  before them; a failure is reported on stderr and stops the
+  benchmark
+-------------------------------------------------------------*/
+static int check(int ok, const char *what) {
+    if (!ok) fprintf(stderr, "bench: check failed: %s\n", what);
+    return ok;
+}
+
+/* Helpers of the adjacency checks: nbr equals the adjacency
+   built by triangle_adjacency, half-edge e joins a and b */
+static int same_adjacency(const int *tri, int nt, int nv, const int *nbr) {
+    Grid2DWork w = GRID2D_WORK_INIT;
+    int *ref = malloc(3 * (size_t)nt * sizeof(int));
+    int same = ref && triangle_adjacency(&w, tri, nt, nv, ref) &&
+               !memcmp(ref, nbr, 3 * (size_t)nt * sizeof(int));
+    free(ref);
+    grid2d_work_free(&w);
+    return same;
+}
+
+static int edge_is(const int *tri, int e, int a, int b) {
+    int u = tri[e], v = tri[e - e % 3 + (e % 3 + 1) % 3];
+    return (u == a && v == b) || (u == b && v == a);
+}
+
+static int bench_checks(void) {
+    int ok = 1;
+
+    /* Batch with empty curves: the slots must follow the non-empty
+       ones exactly, the guard after them must be left alone */
+    {
+        double x[8], y[8];
+        for (int k = 0; k < 8; k++) { x[k] = k; y[k] = 0.1 * k * k; }
+        int off[] = { 0, 0, 5, 5, 5, 8 }, nc = 5, off0[6];
+        int size = parallel_batch_size(off, nc);
+        double x0[16], y0[16];
+        for (int k = 0; k < 16; k++) x0[k] = y0[k] = -1234.5;
+        int r = build_parallel_batch(x, y, off, nc, 0.1, 0.0, 1e30, x0 + 1, y0 + 1, off0);
+        double ex[9], ey[9];
+        int m1 = build_parallel_curve(x, y, 5, 0.1, 0.0, 1e30, ex, ey, 9, 0);
+        int m2 = build_parallel_curve(x + 5, y + 5, 3, 0.1, 0.0, 1e30, ex + m1, ey + m1, 5, 0);
+        ok &= check(size == 14, "parallel_batch_size with empty curves");
+        ok &= check(x0[0] == -1234.5 && y0[0] == -1234.5 &&
+                    x0[size + 1] == -1234.5 && y0[size + 1] == -1234.5,
+                    "parallel_batch writes outside its slots");
+        ok &= check(r == m1 + m2 && off0[0] == 0 && off0[1] == 0 && off0[2] == m1 &&
+                    off0[3] == m1 && off0[4] == m1 && off0[5] == m1 + m2 &&
+                    !memcmp(x0 + 1, ex, r * sizeof(double)) &&
+                    !memcmp(y0 + 1, ey, r * sizeof(double)),
+                    "parallel_batch with empty curves");
+    }
+
+    /* Closed curves: the first and last segments meet at the start
+       and are not a loop; the inward offset of a circle, closed
+       with close_offset_curve, keeps all its points. An open alpha
+       whose ends cross keeps its tails */
+    {
+        enum { NC = 201 };
+        double x[NC], y[NC], x0[2 * NC - 1], y0[2 * NC - 1];
+        double sx[] = { 0, 1, 1, 0, 0 }, sy[] = { 0, 0, 1, 1, 0 };
+        ok &= check(remove_self_intersections(sx, sy, 5) == 5 && sx[2] == 1 && sy[2] == 1,
+                    "remove_self_intersections on a closed square");
+        for (int k = 0; k < NC; k++) {
+            x[k] = cos(2 * M_PI * k / (NC - 1));
+            y[k] = sin(2 * M_PI * k / (NC - 1));
+        }
+        x[NC-1] = x[0];
+        y[NC-1] = y[0];
+        int m = build_parallel_curve(x, y, NC, 0.1, 0.0, 1e30, x0, y0, 2 * NC - 1, 0);
+        close_offset_curve(x0, y0, m);
+        int r = remove_self_intersections(x0, y0, m);
+        ok &= check(r == m && x0[0] == x0[r-1] && y0[0] == y0[r-1] &&
+                    fabs(hypot(x0[r/2], y0[r/2]) - 0.9) < 1e-3,
+                    "remove_self_intersections on the inward offset of a circle");
+        ok &= check(remove_self_intersections(x, y, NC) == NC,
+                    "remove_self_intersections on a closed circle");
+        double ax[] = { -2, 2, 2, -2 }, ay[] = { -1, 1, -1, 1 };
+        r = remove_self_intersections(ax, ay, 4);
+        ok &= check(r == 3 && ax[0] == -2 && ay[0] == -1 && ax[1] == 0 && ay[1] == 0 &&
+                    ax[2] == -2 && ay[2] == 1,
+                    "remove_self_intersections on an open alpha");
+    }
+
+    /* Repair mode on the sine band of n = 100, which fill_between
+       rejects and edge flips alone do not fix: every triangle must
+       come out CCW, with the band area unchanged */
+    {
+        enum { NS = 100 };
+        double x[3 * NS], y[3 * NS];
+        int ia[2 * NS], ib[NS], tri[9 * NS], rep[3 * NS], nrep, nbad;
+        make_curve(SINE, NS, x, y);
+        int m = build_parallel_curve(x, y, NS, 0.05, 0.0, 1e30, x + NS, y + NS, 2 * NS - 1, 0);
+        m = remove_self_intersections(x + NS, y + NS, m);
+        for (int k = 0; k < m; k++) ia[k] = NS + k;
+        for (int k = 0; k < NS; k++) ib[k] = k;
+        int r = fill_between_repair(x, y, ia, m, ib, NS, tri, rep, &nrep, &nbad);
+        double area = 0.0, bound = 0.0;
+        int inv = 0;
+        for (int t = 0; t < r; t++) {
+            const int *v = tri + 3 * t;
+            double a = orient2d(x[v[0]], y[v[0]], x[v[1]], y[v[1]], x[v[2]], y[v[2]]);
+            inv += a < 0.0;
+            area += a;
+        }
+        for (int k = 0; k < m + NS; k++) {
+            int p = k < m ? ia[m - 1 - k] : ib[k - m];
+            int q = k + 1 < m ? ia[m - 2 - k] : k + 1 < m + NS ? ib[k + 1 - m] : ia[m - 1];
+            bound += x[p] * y[q] - x[q] * y[p];
+        }
+        ok &= check(r == m + NS - 2 && nrep > 0 && nbad == 0 && inv == 0 &&
+                    fabs(area - bound) < 1e-9 * fabs(bound),
+                    "fill_between_repair on the sine band of 100 points");
+    }
+
+    /* Incremental band: random local edits applied through
+       update_band_state must give the offset of a rebuild on the
+       same moved curve (count, points per segment, positions),
+       and as many non-CCW triangles as the rebuild (none here) */
+    {
+        enum { NB = 200, NE = 500 };
+        double x[NB], y[NB];
+        int tri[3 * (3 * NB - 3)];
+        BandState bs = BAND_STATE_INIT, rb = BAND_STATE_INIT;
+        Grid2DWork w = GRID2D_WORK_INIT;
+        make_curve(SPIRAL, NB, x, y);
+        int r = build_band_state(&bs, &w, x, y, NB, 0.5, 0.01, 0.6);
+        int e = 0, bad = 0;
+        unsigned s = 4321;
+        for (; r && e < NE && !bad; e++) {
+            s = s * 1103515245u + 12345u;
+            int v0 = (int)((s >> 8) % NB), v1 = v0 + (int)((s >> 4) % 3);
+            if (v1 > NB - 1) v1 = NB - 1;
+            for (int v = v0; v <= v1; v++) {
+                s = s * 1103515245u + 12345u;
+                y[v] += ((s >> 8) / 16777216.0 - 0.5) * 0.02;
+            }
+            int dirty[2] = { v0, v1 };
+            r = update_band_state(&bs, &w, x, y, dirty, 1);
+            if (!r || !build_band_state(&rb, &w, x, y, NB, 0.5, 0.01, 0.6)) break;
+            bad = bs.m != rb.m || bs.nt != rb.nt || memcmp(bs.nc, rb.nc, NB - 1);
+            for (int v = NB; v < 3 * NB - 1 && !bad; v++) {
+                int i = SLOT_SEG(NB, v);
+                int used = v == NB || (v == SLOT_C(NB, i) ? rb.nc[i] == 2 : rb.nc[i] >= 1);
+                bad = used && (bs.xv[v] != rb.xv[v] || bs.yv[v] != rb.yv[v]);
+            }
+            for (int k = 0; k < 2 && !bad; k++) {
+                BandState *b = k ? &rb : &bs;
+                band_state_triangles(b, tri);
+                for (int t = 0; t < b->nt; t++) {
+                    const int *v = tri + 3 * t;
+                    bad += (k ? -1 : 1) * (orient2d(b->xv[v[0]], b->yv[v[0]], b->xv[v[1]], b->yv[v[1]],
+                                                    b->xv[v[2]], b->yv[v[2]]) <= 0.0);
+                }
+            }
+        }
+        ok &= check(e == NE && !bad, "update_band_state against build_band_state");
+        free_band_state(&bs);
+        free_band_state(&rb);
+        grid2d_work_free(&w);
+    }
+
+    /* Adjacency of the zipper: fill_between_adj on single bands
+       (tiny ones included) and build_band_layers_adj on six
+       stitched layers must give the neighbours of
+       triangle_adjacency, and list the boundary in order */
+    {
+        enum { NA = 200 };
+        double x[3 * NA], y[3 * NA];
+        int ia[2 * NA], ib[NA], tri[9 * NA], nbr[9 * NA], bnd[3 * NA];
+        int good = 1;
+        for (int c = 0; c < 3; c++) {
+            int n = c == 0 ? 2 : c == 1 ? 3 : NA, m;
+            if (c < 2) {
+                double tx[] = { 0, 1, 2 }, ty[] = { 1, 1.2, 1 };
+                for (int k = 0; k < n; k++) { x[k] = k; y[k] = 0; }
+                for (m = 0; m < 2; m++) { x[n + m] = tx[m]; y[n + m] = ty[m]; }
+            } else {
+                make_curve(ZIGZAG, n, x, y);
+                m = build_parallel_curve(x, y, n, 0.2 * 100.0 / n, 0.0, 1e30,
+                                         x + n, y + n, 2 * n - 1, 0);
+                m = remove_self_intersections(x + n, y + n, m);
+            }
+            for (int k = 0; k < m; k++) ia[k] = n + k;
+            for (int k = 0; k < n; k++) ib[k] = k;
+            int r = fill_between_adj(x, y, ia, m, ib, n, tri, nbr, bnd);
+            good &= r == n + m - 2 && same_adjacency(tri, r, n + m, nbr);
+            for (int k = 0; k < m - 1 && good; k++) good &= edge_is(tri, bnd[k], ia[k], ia[k+1]);
+            for (int k = 0; k < n - 1 && good; k++) good &= edge_is(tri, bnd[m - 1 + k], ib[k], ib[k+1]);
+            good &= good && edge_is(tri, bnd[n + m - 2], ia[0], ib[0]) &&
+                    edge_is(tri, bnd[n + m - 1], ia[m - 1], ib[n - 1]);
+            for (int k = 0; k < n + m && good; k++) good &= nbr[bnd[k]] == -1;
+        }
+        ok &= check(good, "fill_between_adj against triangle_adjacency");
+
+        enum { NL = 6 };
+        double th[NL] = { 0.2, 0.2, 0.2, 0.2, 0.2, 0.2 };
+        double *xv, *yv;
+        int *lay, *lt, *ln, *lb, nt, nb;
+        make_curve(SPIRAL, NA, x, y);
+        int nv = build_band_layers_adj(x, y, NA, NL, th, 0.0, 1e30,
+                                       &xv, &yv, &lay, &lt, &nt, &ln, &lb, &nb);
+        good = nv > 0 && same_adjacency(lt, nt, nv, ln);
+        int free_edges = 0, q = 0;
+        for (int e = 0; good && e < 3 * nt; e++) free_edges += ln[e] < 0;
+        good &= free_edges == nb;
+        for (int k = 0; good && k < lay[1] - 1; k++) good &= edge_is(lt, lb[q++], k, k + 1);
+        for (int b = 1; good && b <= NL; b++) {
+            good &= edge_is(lt, lb[q++], lay[b], lay[b-1]) &&
+                    edge_is(lt, lb[q++], lay[b+1] - 1, lay[b] - 1);
+        }
+        for (int k = lay[NL]; good && k < lay[NL+1] - 1; k++) good &= edge_is(lt, lb[q++], k, k + 1);
+        for (int k = 0; good && k < nb; k++) good &= ln[lb[k]] == -1;
+        ok &= check(good && q == nb, "build_band_layers_adj against triangle_adjacency");
+        if (nv) { free(xv); free(yv); free(lay); free(lt); free(ln); free(lb); }
+    }
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int nmax = 1000000;
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "-csv")) emit_csv = 1;
+        else nmax = atoi(argv[a]);
+    }
+    if (nmax < 10) nmax = 10;
+
+    Case c;
+    c.x = malloc(3 * (size_t)nmax * sizeof(double));
+    c.y = malloc(3 * (size_t)nmax * sizeof(double));
+    c.x0 = malloc(2 * (size_t)nmax * sizeof(double));
+    c.y0 = malloc(2 * (size_t)nmax * sizeof(double));
+    c.ia = malloc(2 * (size_t)nmax * sizeof(int));
+    c.ib = malloc((size_t)nmax * sizeof(int));
+    c.ind = malloc((size_t)nmax * sizeof(int));
+    c.tri = malloc(9 * (size_t)nmax * sizeof(int));
+    if (!c.x || !c.y || !c.x0 || !c.y0 || !c.ia || !c.ib || !c.ind || !c.tri) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 1;
+    }
+
+    if (!bench_checks()) return 1;
+
+    if (emit_csv) printf("kernel,curve,n,ns_per_vertex,bytes_per_vertex\n");
+    else printf("%-11s %-7s %9s %10s %10s\n", "kernel", "curve", "n", "ns/vertex", "B/vertex");
+
+    for (int curve = 0; curve < NCURVES; curve++) {
+        for (int n = 10; n <= nmax; n *= 10) {
+            make_curve(curve, n, c.x, c.y);
+            for (int k = 0; k < n; k++) { c.ib[k] = k; c.ind[k] = k + 1; }
+            c.n = n;
+            c.h = curve == ZIGZAG ? 0.2 * 100.0 / n : 0.05;
+            bench_case(&c, curve);
+        }
+    }
+
+    free(c.x); free(c.y); free(c.x0); free(c.y0);
+    free(c.ia); free(c.ib); free(c.ind); free(c.tri);
+    return 0;
+}
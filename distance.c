@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Signed distance field of a curve on a Cartesian grid
+  -------------------------------------------------------------
+  The grid has nx by ny nodes (x0 + i*dx, y0 + j*dx), stored row
+  after row: phi[j*nx + i]. The distance is signed as the offsets
+  of build_parallel_curve: positive on the left of the polyline
+  (x[i], y[i]), negative on its right.
+
+  - Narrow band: the nodes within band*dx of the curve get their
+    exact distance to the segments. The grid is cut into tiles of
+    DIST_TILE x DIST_TILE nodes, every segment is binned into the
+    tiles its box (grown by the band) covers, and the tiles are
+    processed in parallel, each node only looking at the segments
+    of its tile. The sign is the side of the closest segment, or,
+    when the closest point is a vertex, the side of the sum of the
+    normals of the two segments at it (the pseudo-normal, which
+    gives the right side at convex and concave corners alike).
+  - Outside the band: fast sweeping of the closest segment. Every
+    node keeps the segment it is closest to; a sweep (in the four
+    diagonal directions) gives each node outside the band the
+    closest of the segments of its two upwind neighbours, with
+    its exact distance and side. Unlike an upwind update of
+    |grad phi| = 1, this has no discretization error (the segment
+    found is the closest one except where the region of a segment
+    is too thin to be carried from node to node), and the sign
+    behind the ends of an open curve follows the extension of its
+    end segments instead of drifting along the grid axes. For a
+    sweep direction a tile only depends on the tiles before it in
+    that direction, so the tiles are swept one anti-diagonal at a
+    time, those of an anti-diagonal in parallel (they share no
+    edge of the 5-point stencil). The four sweeps are repeated
+    until nothing changes.
+
+  distance_contour extracts the level phi = h by marching squares,
+  as polylines with phi > h on their left, which for a curve on
+  the grid is its offset at distance h, in the same direction.
+  Unlike build_parallel_curve it has no folds to clean for large
+  h: the level set of a distance has none. The crossings are
+  numbered by the grid edge they lie on, so the segments of the
+  cells are chained into polylines without any search. A cell
+  over which phi varies by more than 2*dx (a distance varies by
+  dx*sqrt(2) at most) straddles the jump of the sign beyond the
+  ends of an open curve, which is not a level line, and is
+  skipped.
+
+  The scratch arrays are taken from the arena of a workspace
+  (see workspace.c).
+-------------------------------------------------------------*/
+
+#define DIST_TILE 64         // nodes per tile side
+#define DIST_ROUNDS 32       // maximum rounds of the four sweeps
+
+/*-------------------------------------------------------------
+  Helper: squared distance from (px, py) to the segment s of the
+  curve, and its side (+1 left, -1 right) in *sg. (nvx, nvy) are
+  the pseudo-normals of the vertices.
+-------------------------------------------------------------*/
+static double segment_dist2(const double *x, const double *y, const double *nvx,
+                            const double *nvy, int s, double px, double py, int *sg) {
+    double ex = x[s+1] - x[s], ey = y[s+1] - y[s];
+    double ax = px - x[s], ay = py - y[s];
+    double l2 = ex * ex + ey * ey;
+    double t = l2 > 0.0 ? (ax * ex + ay * ey) / l2 : 0.0;
+    double side;
+    if (t <= 0.0) {
+        side = ax * nvx[s] + ay * nvy[s];
+        t = 0.0;
+    } else if (t >= 1.0) {
+        side = (px - x[s+1]) * nvx[s+1] + (py - y[s+1]) * nvy[s+1];
+        t = 1.0;
+    } else {
+        side = ex * ay - ey * ax;
+    }
+    *sg = side < 0.0 ? -1 : 1;
+    double dx = ax - t * ex, dy = ay - t * ey;
+    return dx * dx + dy * dy;
+}
+
+/*-------------------------------------------------------------
+  Helper: give the node k = j*nx + i the closest of the segments
+  of its two upwind neighbours, those already swept in the
+  direction (fi, fj) (1 for a flipped axis). phi holds signed
+  squared distances while sweeping, so that equal distances (the
+  two segments at a vertex) compare equal. Returns 1 if its
+  distance went down.
+-------------------------------------------------------------*/
+static inline int sweep_node(const double *x, const double *y, const double *nvx,
+                             const double *nvy, double *phi, int *near,
+                             double x0, double y0, double dx, int nx, int ny,
+                             int i, int j, int fi, int fj) {
+    int k = j * nx + i, nb[2], down = 0;
+    nb[0] = !fi ? (i > 0 ? near[k-1] : -1) : (i < nx - 1 ? near[k+1] : -1);
+    nb[1] = !fj ? (j > 0 ? near[k-nx] : -1) : (j < ny - 1 ? near[k+nx] : -1);
+    double px = x0 + i * dx, py = y0 + j * dx, best = fabs(phi[k]);
+    for (int q = 0; q < 2; q++) {
+        if (nb[q] < 0 || nb[q] == near[k]) continue;
+        int sg;
+        double d2 = segment_dist2(x, y, nvx, nvy, nb[q], px, py, &sg);
+        if (d2 < best) {
+            best = d2;
+            phi[k] = sg * d2;
+            near[k] = nb[q];
+            down = 1;
+        }
+    }
+    return down;
+}
+
+/*-------------------------------------------------------------
+  Signed distance field of the polyline (x[i], y[i])
+  -------------------------------------------------------------
+  phi[nx*ny] receives the field. If the band holds no node, all
+  of them are left at HUGE_VAL.
+  Returns the number of nodes in the narrow band (0 if the curve
+  is farther than band*dx from the grid), or -1 if out of memory.
+-------------------------------------------------------------*/
+int curve_distance_field(
+    Grid2DWork *w,
+    double *x, double *y, int n,     // Curve
+    double x0, double y0, double dx, // Grid origin and spacing
+    int nx, int ny,                  // Grid nodes
+    int band,                        // Narrow band, in cells
+    double *phi                      // Output: nx*ny values
+) {
+    grid2d_work_reset(w);
+    size_t nn = (size_t)nx * ny;
+    for (size_t k = 0; k < nn; k++) phi[k] = HUGE_VAL;
+    if (n < 2 || nx < 1 || ny < 1 || !(dx > 0.0)) return 0;
+
+    int ti = (nx + DIST_TILE - 1) / DIST_TILE, tj = (ny + DIST_TILE - 1) / DIST_TILE;
+    int ntile = ti * tj;
+    double r = (band > 1 ? band : 1) * dx;
+    double *nvx = grid2d_work_alloc(w, n * sizeof(double));
+    double *nvy = grid2d_work_alloc(w, n * sizeof(double));
+    int *start = grid2d_work_alloc(w, (ntile + 1) * sizeof(int));
+    int *near = grid2d_work_alloc(w, nn * sizeof(int));
+    unsigned char *fixed = grid2d_work_alloc(w, nn);
+    if (!nvx || !nvy || !start || !near || !fixed) return -1;
+
+    /* ---- Pseudo-normals: sum of the left unit normals ---- */
+    for (int v = 0; v < n; v++) nvx[v] = nvy[v] = 0.0;
+    for (int s = 0; s < n - 1; s++) {
+        double ex = x[s+1] - x[s], ey = y[s+1] - y[s];
+        double l = sqrt(ex * ex + ey * ey);
+        if (l == 0.0) continue;
+        nvx[s] -= ey / l; nvy[s] += ex / l;
+        nvx[s+1] -= ey / l; nvy[s+1] += ex / l;
+    }
+
+    /* ---- Bin the segments into the tiles of their grown box ---- */
+#define SEG_TILES(s, i0, i1, j0, j1)                                            \
+    double bx0 = fmin(x[s], x[s+1]) - r, bx1 = fmax(x[s], x[s+1]) + r;          \
+    double by0 = fmin(y[s], y[s+1]) - r, by1 = fmax(y[s], y[s+1]) + r;          \
+    int i0 = (int)fmax(ceil((bx0 - x0) / dx), 0.0);                             \
+    int i1 = (int)fmin(floor((bx1 - x0) / dx), nx - 1.0);                       \
+    int j0 = (int)fmax(ceil((by0 - y0) / dx), 0.0);                             \
+    int j1 = (int)fmin(floor((by1 - y0) / dx), ny - 1.0);
+    memset(start, 0, (ntile + 1) * sizeof(int));
+    for (int s = 0; s < n - 1; s++) {
+        SEG_TILES(s, i0, i1, j0, j1);
+        for (int b = j0 / DIST_TILE; b <= j1 / DIST_TILE && i0 <= i1; b++)
+            for (int a = i0 / DIST_TILE; a <= i1 / DIST_TILE; a++) start[b * ti + a + 1]++;
+    }
+    for (int t = 0; t < ntile; t++) start[t+1] += start[t];
+    int *seg = grid2d_work_alloc(w, ((size_t)start[ntile] + 1) * sizeof(int));
+    int *fill = grid2d_work_alloc(w, ntile * sizeof(int));
+    if (!seg || !fill) return -1;
+    memcpy(fill, start, ntile * sizeof(int));
+    for (int s = 0; s < n - 1; s++) {
+        SEG_TILES(s, i0, i1, j0, j1);
+        for (int b = j0 / DIST_TILE; b <= j1 / DIST_TILE && i0 <= i1; b++)
+            for (int a = i0 / DIST_TILE; a <= i1 / DIST_TILE; a++) seg[fill[b * ti + a]++] = s;
+    }
+
+    /* ---- Narrow band: exact distances, tile by tile, each
+       segment over the nodes of its grown box in the tile ---- */
+    int nband = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:nband)
+    for (int t = 0; t < ntile; t++) {
+        int ti0 = (t % ti) * DIST_TILE, tj0 = (t / ti) * DIST_TILE;
+        int ti1 = ti0 + DIST_TILE < nx ? ti0 + DIST_TILE : nx;
+        int tj1 = tj0 + DIST_TILE < ny ? tj0 + DIST_TILE : ny;
+        for (int j = tj0; j < tj1; j++)
+            for (int i = ti0; i < ti1; i++) {
+                phi[(size_t)j * nx + i] = r * r;
+                near[(size_t)j * nx + i] = -1;
+            }
+        for (int q = start[t]; q < start[t+1]; q++) {
+            int s = seg[q];
+            SEG_TILES(s, i0, i1, j0, j1);
+            if (i0 < ti0) i0 = ti0;
+            if (i1 >= ti1) i1 = ti1 - 1;
+            if (j0 < tj0) j0 = tj0;
+            if (j1 >= tj1) j1 = tj1 - 1;
+            // Distances only; the side is taken once per node below
+            double ex = x[s+1] - x[s], ey = y[s+1] - y[s];
+            double l2 = ex * ex + ey * ey, il2 = l2 > 0.0 ? 1.0 / l2 : 0.0;
+            for (int j = j0; j <= j1; j++) {
+                double ay = y0 + j * dx - y[s];
+                for (int i = i0; i <= i1; i++) {
+                    size_t k = (size_t)j * nx + i;
+                    double ax = x0 + i * dx - x[s];
+                    double u = fmin(fmax((ax * ex + ay * ey) * il2, 0.0), 1.0);
+                    double qx = ax - u * ex, qy = ay - u * ey, d2 = qx * qx + qy * qy;
+                    if (d2 <= phi[k]) { phi[k] = d2; near[k] = s; }
+                }
+            }
+        }
+        for (int j = tj0; j < tj1; j++) {
+            for (int i = ti0; i < ti1; i++) {
+                size_t k = (size_t)j * nx + i;
+                fixed[k] = near[k] >= 0;
+                if (near[k] < 0) { phi[k] = HUGE_VAL; continue; }
+                int sg;
+                segment_dist2(x, y, nvx, nvy, near[k], x0 + i * dx, y0 + j * dx, &sg);
+                phi[k] *= sg;
+                nband++;
+            }
+        }
+    }
+#undef SEG_TILES
+    if (nband == 0) return 0;
+
+    /* ---- Fast sweeping, tiles by anti-diagonals; a tile is
+       swept again only while it or a neighbour changes ---- */
+    unsigned char *dirty = grid2d_work_alloc(w, ntile);
+    if (!dirty) return -1;
+    memset(dirty, 1, ntile);
+    for (int round = 0; round < DIST_ROUNDS; round++) {
+        int changed = 0;
+        for (int dir = 0; dir < 4; dir++) {
+            int fi = dir == 1 || dir == 2, fj = dir >= 2;     // flipped axes
+            for (int d = 0; d <= ti + tj - 2; d++) {
+                int a0 = d - (tj - 1) > 0 ? d - (tj - 1) : 0;
+                int a1 = d < ti - 1 ? d : ti - 1;
+                #pragma omp parallel for schedule(dynamic, 1) reduction(|:changed)
+                for (int a = a0; a <= a1; a++) {
+                    int tx = fi ? ti - 1 - a : a, ty = fj ? tj - 1 - (d - a) : d - a;
+                    int t = ty * ti + tx, ch = 0;
+                    if (!dirty[t]) continue;
+                    dirty[t] = 0;
+                    int i0 = tx * DIST_TILE, j0 = ty * DIST_TILE;
+                    int i1 = i0 + DIST_TILE < nx ? i0 + DIST_TILE : nx;
+                    int j1 = j0 + DIST_TILE < ny ? j0 + DIST_TILE : ny;
+                    for (int jj = j0; jj < j1; jj++) {
+                        int j = fj ? j0 + j1 - 1 - jj : jj;
+                        for (int ii = i0; ii < i1; ii++) {
+                            int i = fi ? i0 + i1 - 1 - ii : ii;
+                            if (!fixed[(size_t)j * nx + i])
+                                ch |= sweep_node(x, y, nvx, nvy, phi, near,
+                                                 x0, y0, dx, nx, ny, i, j, fi, fj);
+                        }
+                    }
+                    if (!ch) continue;
+                    changed = 1;
+                    // Neighbours on other anti-diagonals, shared by
+                    // at most two tiles of this one
+                    #pragma omp atomic write
+                    dirty[t] = 1;
+                    if (tx > 0) {
+                        #pragma omp atomic write
+                        dirty[t-1] = 1;
+                    }
+                    if (tx < ti - 1) {
+                        #pragma omp atomic write
+                        dirty[t+1] = 1;
+                    }
+                    if (ty > 0) {
+                        #pragma omp atomic write
+                        dirty[t-ti] = 1;
+                    }
+                    if (ty < tj - 1) {
+                        #pragma omp atomic write
+                        dirty[t+ti] = 1;
+                    }
+                }
+            }
+        }
+        if (!changed) break;
+    }
+
+    /* ---- Squared distances to distances ---- */
+    #pragma omp parallel for schedule(static)
+    for (size_t k = 0; k < nn; k++)
+        if (phi[k] != HUGE_VAL) phi[k] = copysign(sqrt(fabs(phi[k])), phi[k]);
+    return nband;
+}
+
+/*-------------------------------------------------------------
+  Helper: crossing of the level h on the grid edge e, numbered
+  j*(nx-1) + i for the edge (i,j)-(i+1,j) and nh + j*nx + i for
+  the edge (i,j)-(i,j+1)
+-------------------------------------------------------------*/
+static void edge_crossing(const double *phi, double x0, double y0, double dx, int nx,
+                          int nh, int e, double h, double *px, double *py) {
+    int hor = e < nh, i, j;
+    if (hor) { j = e / (nx - 1); i = e % (nx - 1); }
+    else     { e -= nh; j = e / nx; i = e % nx; }
+    double va = phi[j * nx + i], vb = phi[hor ? j * nx + i + 1 : (j + 1) * nx + i];
+    double t = (h - va) / (vb - va);
+    if (!(t >= 0.0)) t = 0.0;        // also a far node at HUGE_VAL
+    if (t > 1.0) t = 1.0;
+    *px = x0 + (i + (hor ? t : 0.0)) * dx;
+    *py = y0 + (j + (hor ? 0.0 : t)) * dx;
+}
+
+/*-------------------------------------------------------------
+  Level phi = h of a grid field, as polylines
+  -------------------------------------------------------------
+  Polyline p is (*cx, *cy)[(*off)[p] .. (*off)[p+1]-1], with
+  phi > h on its left; a closed one repeats its first point at
+  the end. *cx, *cy are the offset buffers of w and *off is in
+  its arena: all stay valid until the next call that uses w.
+  Returns the number of polylines, or -1 if out of memory.
+-------------------------------------------------------------*/
+int distance_contour(
+    Grid2DWork *w,
+    const double *phi,               // Field, nx*ny values
+    double x0, double y0, double dx, // Grid origin and spacing
+    int nx, int ny,                  // Grid nodes
+    double h,                        // Level
+    double **cx, double **cy,        // Output: points
+    int **off                        // Output: first point of each polyline
+) {
+    grid2d_work_reset(w);
+    *cx = *cy = NULL;
+    *off = NULL;
+    if (nx < 2 || ny < 2) return 0;
+
+    int nh = (nx - 1) * ny, ne = nh + nx * (ny - 1);
+    int *nxt = grid2d_work_alloc(w, ne * sizeof(int));
+    unsigned char *st = grid2d_work_alloc(w, ne);
+    if (!nxt || !st) return -1;
+    for (int e = 0; e < ne; e++) nxt[e] = -1;
+    memset(st, 0, ne);
+
+    /* ---- Marching squares: each cell links its exit crossings
+       (phi > h to phi <= h, going round it counterclockwise) to
+       its entry crossings; every crossing is an exit of one of
+       its two cells only ---- */
+    int nseg = 0;
+    #pragma omp parallel for schedule(static) reduction(+:nseg)
+    for (int j = 0; j < ny - 1; j++) {
+        for (int i = 0; i < nx - 1; i++) {
+            int k = j * nx + i;
+            double v[4] = { phi[k], phi[k+1], phi[k+nx+1], phi[k+nx] };
+            int in[4], edge[4];
+            for (int c = 0; c < 4; c++) in[c] = v[c] > h;
+            if (in[0] == in[1] && in[1] == in[2] && in[2] == in[3]) continue;
+            if (fmax(fmax(v[0], v[1]), fmax(v[2], v[3])) -
+                fmin(fmin(v[0], v[1]), fmin(v[2], v[3])) > 2.0 * dx) continue;    // sign jump
+            edge[0] = j * (nx - 1) + i;
+            edge[1] = nh + j * nx + i + 1;
+            edge[2] = (j + 1) * (nx - 1) + i;
+            edge[3] = nh + j * nx + i;
+            int saddle = in[0] == in[2] && in[1] == in[3];
+            int centre = 0.25 * (v[0] + v[1] + v[2] + v[3]) > h;
+            for (int c = 0; c < 4; c++) {
+                if (!in[c] || in[(c+1) & 3]) continue;      // not an exit
+                int m;
+                if (saddle) m = centre ? (c + 1) & 3 : (c + 3) & 3;
+                else for (m = 0; in[m] || !in[(m+1) & 3]; m++) {}
+                nxt[edge[c]] = edge[m];
+                nseg++;
+            }
+        }
+    }
+
+    int *o = grid2d_work_alloc(w, (nseg + 1) * sizeof(int));
+    if (!o || !grid2d_work_reserve_xy(w, 2 * nseg + 1)) return -1;
+    double *px = w->x0, *py = w->y0;
+    for (int e = 0; e < ne; e++) if (nxt[e] >= 0) st[nxt[e]] |= 1;    // has a predecessor
+
+    /* ---- Chain: open polylines from the border, then loops ---- */
+    int np = 0, nl = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int e0 = 0; e0 < ne; e0++) {
+            if (nxt[e0] < 0 || (st[e0] & 2) || (pass == 0 && (st[e0] & 1))) continue;
+            o[nl++] = np;
+            int e = e0;
+            do {
+                st[e] |= 2;
+                edge_crossing(phi, x0, y0, dx, nx, nh, e, h, px + np, py + np);
+                np++;
+                e = nxt[e];
+            } while (e >= 0 && e != e0);
+            if (e == e0) {                   // closed: repeat the first point
+                px[np] = px[o[nl-1]];
+                py[np] = py[o[nl-1]];
+                np++;
+            }
+        }
+    }
+    o[nl] = np;
+    *cx = px; *cy = py; *off = o;
+    return nl;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the signed distance field
+  Inputs (D*):
+    x, y   : double arrays with the curve
+    org    : double array with the grid origin x0, y0
+    dx     : double, grid spacing
+    size   : integer array with the grid nodes nx, ny
+    band   : integer, narrow band in cells
+  Returns: double array with the nx*ny values, row after row, or
+  DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_distance_field6(D *x, D *y, D *org, D *dx, D *size, D *band) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(band);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        org->t != D_TIPO_DOUBLE || dx->t != D_TIPO_DOUBLE ||
+        size->t != D_TIPO_INT || band->t != D_TIPO_INT) {
+        DError("distance_field : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(band);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || x->n < 2 || org->n != 2 || dx->n != 1 || !(dx->p.d[0] > 0.0) ||
+        size->n != 2 || size->p.i[0] < 1 || size->p.i[1] < 1 || band->n != 1) {
+        DError("distance_field : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(band);
+        return DCreaNulo();
+    }
+
+    int nx = size->p.i[0], ny = size->p.i[1];
+    D *phi = DCreaDouble(nx * ny);
+    int nb = curve_distance_field(grid2d_d_work(), x->p.d, y->p.d, x->n,
+                                  org->p.d[0], org->p.d[1], dx->p.d[0],
+                                  nx, ny, band->p.i[0], phi->p.d);
+    if (nb <= 0) {
+        DLibera(phi);
+        phi = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(org);
+    DLibera(dx);
+    DLibera(size);
+    DLibera(band);
+    return phi;
+}
+
+/*-------------------------------------------------------------
+  Wrapper for the level lines of a grid field
+  Inputs (D*):
+    phi    : double array with the nx*ny values, row after row
+    org    : double array with the grid origin x0, y0
+    dx     : double, grid spacing
+    size   : integer array with the grid nodes nx, ny
+    h      : double, level
+  Returns: D list with the points cx, cy of all the polylines
+  and the first point of each one off (one more entry than
+  polylines, the last being the number of points), or
+  DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_distance_contour5(D *phi, D *org, D *dx, D *size, D *h) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(phi);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(h);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (phi->t != D_TIPO_DOUBLE || org->t != D_TIPO_DOUBLE ||
+        dx->t != D_TIPO_DOUBLE || size->t != D_TIPO_INT || h->t != D_TIPO_DOUBLE) {
+        DError("distance_contour : bad argument type");
+        DLibera(phi);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(h);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (org->n != 2 || dx->n != 1 || !(dx->p.d[0] > 0.0) || size->n != 2 ||
+        size->p.i[0] < 2 || size->p.i[1] < 2 ||
+        phi->n != size->p.i[0] * size->p.i[1] || h->n != 1) {
+        DError("distance_contour : bad argument size");
+        DLibera(phi);
+        DLibera(org);
+        DLibera(dx);
+        DLibera(size);
+        DLibera(h);
+        return DCreaNulo();
+    }
+
+    // Level lines into the buffers of the shared workspace, then
+    // copied to D structures of the exact size
+    double *cx, *cy;
+    int *off;
+    int np = distance_contour(grid2d_d_work(), phi->p.d, org->p.d[0], org->p.d[1],
+                              dx->p.d[0], size->p.i[0], size->p.i[1], h->p.d[0],
+                              &cx, &cy, &off);
+
+    D *output;
+    if (np >= 0) {
+        int npt = off ? off[np] : 0;
+        D *dcx = DCreaDouble(npt > 0 ? npt : 1);
+        D *dcy = DCreaDouble(npt > 0 ? npt : 1);
+        D *doff = DCreaInt(np + 1);
+        if (npt > 0) {
+            memcpy(dcx->p.d, cx, npt * sizeof(double));
+            memcpy(dcy->p.d, cy, npt * sizeof(double));
+        }
+        dcx->n = dcy->n = npt;
+        if (off) memcpy(doff->p.i, off, (np + 1) * sizeof(int));
+        else doff->p.i[0] = 0;
+
+        output = DCreaLista();
+        DInserta(output, dcx);
+        DInserta(output, dcy);
+        DInserta(output, doff);
+    } else {
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(phi);
+    DLibera(org);
+    DLibera(dx);
+    DLibera(size);
+    DLibera(h);
+    return output;
+}
+
+#endif
@@ -0,0 +1,440 @@
+#ifndef FILL_ENGINE_H
+#define FILL_ENGINE_H
+
+#include "grid2d.h"
+#include "predicates.h"
+
+/* ===========================================================
+   Band zipper engine
+   =========================================================== */
+
+/*
+ * The zipper loop of fill_between, written once as a template.
+ * The includer sets the policies with macros and includes this
+ * file, which defines one static function; included without
+ * FE_NAME it only declares the common helpers.
+ *
+ * Policies:
+ *   FE_NAME    name of the generated function (required)
+ *   FE_REPAIR  0  return 0 at the first spot where both candidate
+ *                 triangles are inverted (SABC < 0 && SABD < 0)
+ *              1  repair such spots locally and go on:
+ *                 the least inverted of the two candidates is
+ *                 emitted, then the edge it shares with the
+ *                 previous triangle, or else with the next one,
+ *                 is flipped if that makes both triangles CCW.
+ *                 Inverted triangles of the closing strips are
+ *                 treated the same way. The indices of the
+ *                 triangles emitted or changed by a repair are
+ *                 stored in rep (at most na + nb - 2 entries) and
+ *                 their number in *nrep. A spot no flip can fix
+ *                 keeps an inverted triangle, listed in rep too;
+ *                 side[k] records whether triangle k advanced
+ *                 along ia (0) or ib (1), so that the caller can
+ *                 find the window of the curves such a triangle
+ *                 spans and zip it again (fill_between_repair).
+ *
+ *   FE_INPUT   FE_INDEX   curve vertices given by index arrays
+ *                         ia[0..na-1], ib[0..nb-1]
+ *              FE_RANGE   curve vertices in arithmetic progression:
+ *                         a0 + k*sa, b0 + k*sb
+ *
+ *   FE_SINK    FE_ARRAY   triangles stored in tri[3*(na+nb-2)]
+ *              FE_STREAM  triangles written to a block buffer of
+ *                         kblk >= 2 triangles; when it is full, all
+ *                         of them but the last (which a repair may
+ *                         still flip) are passed to sink(ctx, ...)
+ *                         and the block starts again. A sink
+ *                         returning 0 stops the zipper.
+ *
+ *   FE_FLOAT   0  double coordinates
+ *              1  float coordinates (real below), read once into
+ *                 the double registers of the zipper: the
+ *                 orientation tests and distances are computed in
+ *                 double on the promoted values, so the signs are
+ *                 exact for the float geometry and the zipper takes
+ *                 the same decisions as on a double copy of it.
+ *                 Only the loads are narrower (not with FE_REPAIR)
+ *
+ *   FE_ADJ     0  triangles only
+ *              1  also the adjacency, built as the triangles are
+ *                 emitted (FE_ARRAY, not with FE_REPAIR): each
+ *                 triangle shares its edge 0 (A -> B) with the
+ *                 previous one and one of edges 1, 2 with the next
+ *                 one, the third lies on a curve.
+ *                 nbr[3*(na+nb-2)]: nbr[3t+k] = 3s+l when edge k
+ *                 of t is edge l of s, -1 on the boundary (the
+ *                 layout of triangle_adjacency in quality.c)
+ *                 bnd[na+nb]: the boundary half-edges 3t+k,
+ *                 bnd[i] the one on the segment i, i+1 of ia
+ *                 (i < na-1), bnd[na-1+j] the one on the segment
+ *                 j, j+1 of ib (j < nb-1), then the two ends of
+ *                 the band, ia[0]-ib[0] and ia[na-1]-ib[nb-1]
+ *
+ * Generated signature:
+ *   int FE_NAME(real *x, real *y,
+ *               int *ia, int na, int *ib, int nb,    (FE_INDEX)
+ *               int a0, int sa, int na,
+ *               int b0, int sb, int nb,              (FE_RANGE)
+ *               int *tri                             (FE_ARRAY)
+ *               int *blk, int kblk,
+ *               FillSink sink, void *ctx             (FE_STREAM)
+ *               [, int *rep, int *nrep,
+ *                  unsigned char *side]              (FE_REPAIR)
+ *               [, int *nbr, int *bnd])              (FE_ADJ)
+ *
+ * The zipper keeps A, B, C, D and their coordinates in sliding
+ * registers, so each step loads one new point, and reuses the
+ * area SCBD or SADC of a step as the SABD or SABC of the next one
+ * (same points in the same order, so the same exact sign).
+ *
+ * real is double, or float with FE_FLOAT.
+ * Returns the number of triangles (na + nb - 2), or 0 on failure.
+ * With FE_STREAM, triangles passed to the sink before a failure
+ * are not taken back.
+ */
+
+#define FE_INDEX   0
+#define FE_RANGE   1
+
+#define FE_ARRAY   0
+#define FE_STREAM  1
+
+// Squared distance between two points (no sqrt needed)
+static inline double fe_dist2(double xa, double ya, double xb, double yb)
+{
+    double dx = xb - xa, dy = yb - ya;
+    return dx * dx + dy * dy;
+}
+
+/*
+ * Helper: flip the edge shared by the consecutive triangles
+ * t1 and t2 (3 indices each) if both new triangles are CCW.
+ * In a zipper strip t1 has the shared edge as u -> v and t2 as
+ * v -> u; with a, b the opposite vertices, the quad a, u, b, v
+ * is split along a-b instead.
+ * Returns 1 if the edge was flipped.
+ */
+static inline int fe_flip(double *x, double *y, int *t1, int *t2)
+{
+    for (int k = 0; k < 3; k++) {
+        int u = t1[k], v = t1[(k+1) % 3], a = t1[(k+2) % 3];
+        for (int l = 0; l < 3; l++) {
+            if (t2[l] != v || t2[(l+1) % 3] != u) continue;
+            int b = t2[(l+2) % 3];
+            if (orient2d(x[a], y[a], x[u], y[u], x[b], y[b]) <= 0.0 ||
+                orient2d(x[a], y[a], x[b], y[b], x[v], y[v]) <= 0.0)
+                return 0;
+            t1[0] = a; t1[1] = u; t1[2] = b;
+            t2[0] = a; t2[1] = b; t2[2] = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Helper (repair mode): triangle t (cur) has just been emitted
+ * after prev, bad says whether it is inverted and *pend is the
+ * last repaired triangle still inverted (-1 if none). An inverted
+ * triangle is flipped with the one before it; a pending one right
+ * before t gets a second chance with t.
+ */
+static inline void fe_repair(double *x, double *y, int *prev, int *cur, int t, int bad,
+                             int *rep, int *nrep, int *pend)
+{
+    if (t > 0 && (bad || *pend == t - 1) && fe_flip(x, y, prev, cur)) {
+        if (*nrep == 0 || rep[*nrep-1] != t - 1) rep[(*nrep)++] = t - 1;
+        rep[(*nrep)++] = t;
+        *pend = -1;
+    } else if (bad) {
+        rep[(*nrep)++] = t;
+        *pend = t;
+    }
+}
+
+#endif
+
+/* ================= template instance ================= */
+
+#ifdef FE_NAME
+
+#ifndef FE_REPAIR
+#define FE_REPAIR 0
+#endif
+
+#ifndef FE_SINK
+#define FE_SINK FE_ARRAY
+#endif
+#ifndef FE_INPUT
+#define FE_INPUT FE_INDEX
+#endif
+
+#ifndef FE_FLOAT
+#define FE_FLOAT 0
+#endif
+#ifndef FE_ADJ
+#define FE_ADJ 0
+#endif
+#if FE_ADJ && (FE_REPAIR || FE_SINK != FE_ARRAY)
+#error "FE_ADJ needs FE_ARRAY and no FE_REPAIR"
+#endif
+#if FE_FLOAT
+#if FE_REPAIR
+#error "FE_FLOAT does not support FE_REPAIR"
+#endif
+#define FE_REAL float
+#else
+#define FE_REAL double
+#endif
+
+#if FE_INPUT == FE_INDEX
+#define FE_INPUT_PARAMS int *ia, int na, int *ib, int nb,
+/* Vertex k of each curve */
+#define FE_IA(k) (ia[k])
+#define FE_IB(k) (ib[k])
+#else
+#define FE_INPUT_PARAMS int a0, int sa, int na, int b0, int sb, int nb,
+#define FE_IA(k) (a0 + (k) * sa)
+#define FE_IB(k) (b0 + (k) * sb)
+#endif
+
+#if FE_SINK == FE_ARRAY
+#define FE_SINK_PARAMS int *tri
+/* Triangle k of the output */
+#define FE_TRI(k) (tri + 3*(k))
+#define FE_FLUSH() ((void)0)
+#else
+#define FE_SINK_PARAMS int *blk, int kblk, FillSink sink, void *ctx
+#define FE_TRI(k) (blk + 3*((k) - base))
+/* Pass a full block to the sink, keeping its last triangle */
+#define FE_FLUSH()                                              \
+    do {                                                        \
+        if (nt - base == kblk) {                                \
+            if (!sink(ctx, blk, kblk - 1)) return 0;            \
+            blk[0] = blk[3*kblk-3];                             \
+            blk[1] = blk[3*kblk-2];                             \
+            blk[2] = blk[3*kblk-1];                             \
+            base = nt - 1;                                      \
+        }                                                       \
+    } while (0)
+#endif
+
+#if FE_REPAIR
+#define FE_REPAIR_PARAMS , int *rep, int *nrep, unsigned char *side
+/* Curve along which triangle nt advances */
+#define FE_SIDE(s) (side[nt] = (s))
+/* Repair step after emitting triangle nt, inverted or not */
+#define FE_CHECK(bad) \
+    fe_repair(x, y, nt > 0 ? FE_TRI(nt-1) : NULL, FE_TRI(nt), nt, bad, rep, nrep, &pend)
+/* Orientation of the last emitted triangle */
+#define FE_INVERTED(t) (orient2d(x[t[0]], y[t[0]], x[t[1]], y[t[1]], x[t[2]], y[t[2]]) < 0.0)
+#else
+#define FE_REPAIR_PARAMS
+#define FE_SIDE(s) ((void)0)
+#define FE_CHECK(bad) ((void)0)
+#endif
+
+#if FE_ADJ
+#define FE_ADJ_PARAMS , int *nbr, int *bnd
+/* Links of triangle nt: edge 0 with the previous triangle, edge
+   fwd (1 or 2) left for the next one, edge 3 - fwd on a curve,
+   stored in bnd[slot] */
+#define FE_LINK(fwd, slot)                                      \
+    do {                                                        \
+        nbr[3*nt] = prev;                                       \
+        if (prev >= 0) nbr[prev] = 3*nt;                        \
+        nbr[3*nt + 3 - (fwd)] = -1;                             \
+        bnd[slot] = 3*nt + 3 - (fwd);                           \
+        prev = 3*nt + (fwd);                                    \
+    } while (0)
+#else
+#define FE_ADJ_PARAMS
+#define FE_LINK(fwd, slot) ((void)0)
+#endif
+
+static int FE_NAME(
+    FE_REAL *x, FE_REAL *y,
+    FE_INPUT_PARAMS
+    FE_SINK_PARAMS FE_REPAIR_PARAMS FE_ADJ_PARAMS)
+{
+    int i = 0, j = 0, nt = 0;
+    int *t;
+#if FE_SINK == FE_STREAM
+    int base = 0;                       // index of the triangle in blk[0]
+    if (kblk < 2) return 0;
+#endif
+    int sel;
+    double SABC, SABD, SADC, SCBD;
+    double DBC, DAC;
+#if FE_REPAIR
+    int pend = -1;
+    *nrep = 0;
+#endif
+#if FE_ADJ
+    int prev = -1;                      // half-edge left for the next triangle
+#endif
+
+    if (na < 1 || nb < 1) return 0;
+
+    // Sliding registers: the points A, B, C, D of the current step,
+    // each one loaded once, and the areas known from the last step
+    int A = FE_IA(0), B = FE_IB(0), C = A, D = B;
+    double xa = x[A], ya = y[A], xb = x[B], yb = y[B];
+    double xc = xa, yc = ya, xd = xb, yd = yb;
+    if (na > 1) { C = FE_IA(1); xc = x[C]; yc = y[C]; }
+    if (nb > 1) { D = FE_IB(1); xd = x[D]; yd = y[D]; }
+    int kabc = 0, kabd = 0;     // SABC, SABD carried over
+
+    // Advance along ia: C becomes A
+#define FE_STEP_A()                                             \
+    do {                                                        \
+        i++;                                                    \
+        A = C; xa = xc; ya = yc;                                \
+        if (i < na - 1) { C = FE_IA(i+1); xc = x[C]; yc = y[C]; } \
+    } while (0)
+    // Advance along ib: D becomes B
+#define FE_STEP_B()                                             \
+    do {                                                        \
+        j++;                                                    \
+        B = D; xb = xd; yb = yd;                                \
+        if (j < nb - 1) { D = FE_IB(j+1); xd = x[D]; yd = y[D]; } \
+    } while (0)
+
+    while (i < na - 1 && j < nb - 1) {
+        // Compute oriented areas (exact signs), unless known
+        if (!kabc) SABC = orient2d(xa, ya, xb, yb, xc, yc);
+        if (!kabd) SABD = orient2d(xa, ya, xb, yb, xd, yd);
+        kabc = kabd = 0;
+
+        if (SABC < 0.0 && SABD < 0.0) {
+#if FE_REPAIR
+            // Emit the least inverted candidate and try to fix it
+            // by a flip with a neighbour triangle
+            t = FE_TRI(nt);
+            t[0] = A;
+            t[1] = B;
+            if (SABC >= SABD) { t[2] = C; FE_SIDE(0); FE_STEP_A(); }
+            else              { t[2] = D; FE_SIDE(1); FE_STEP_B(); }
+            FE_CHECK(1);
+            nt++;
+            FE_FLUSH();
+            continue;
+#else
+            // Both candidates inverted: invalid configuration
+            return 0;
+#endif
+        }
+
+        if (SABC < 0.0) {
+            sel = 1;   // advance along ib
+        } else if (SABD < 0.0) {
+            sel = 0;   // advance along ia
+        } else {
+            // Both triangles OK, check next configurations. After
+            // the step, SCBD is the next SABD if advancing along ia
+            // and SADC the next SABC if advancing along ib
+            SCBD = orient2d(xc, yc, xb, yb, xd, yd);
+            if (SCBD < 0.0) {
+                sel = 0;
+            } else {
+                SADC = orient2d(xa, ya, xd, yd, xc, yc);
+                if (SADC < 0.0) sel = 1;
+                else {
+                    // Compare distances between BC and AD
+                    DBC = fe_dist2(xb, yb, xc, yc);
+                    DAC = fe_dist2(xa, ya, xd, yd);
+                    sel = (DBC < DAC) ? 0 : 1;
+                }
+                if (sel == 1) { SABC = SADC; kabc = 1; }
+            }
+            if (sel == 0) { SABD = SCBD; kabd = 1; }
+        }
+
+        // Build triangle and advance
+        t = FE_TRI(nt);
+        t[0] = A;
+        t[1] = B;
+        if (sel == 0) { // advance along ia
+            t[2] = C;
+            FE_SIDE(0);
+            FE_LINK(1, i);
+            FE_STEP_A();
+        } else {        // advance along ib
+            t[2] = D;
+            FE_SIDE(1);
+            FE_LINK(2, na - 1 + j);
+            FE_STEP_B();
+        }
+        FE_CHECK(0);
+        nt++;
+        FE_FLUSH();
+    }
+#undef FE_STEP_A
+#undef FE_STEP_B
+
+    // Complete the remaining strip
+    while (i < na - 1) {
+        t = FE_TRI(nt);
+        t[0] = FE_IA(i);
+        t[1] = FE_IB(nb-1);
+        t[2] = FE_IA(i+1);
+        FE_SIDE(0);
+        FE_CHECK(FE_INVERTED(t));
+        FE_LINK(1, i);
+        i++;
+        nt++;
+        FE_FLUSH();
+    }
+    while (j < nb - 1) {
+        t = FE_TRI(nt);
+        t[0] = FE_IA(na-1);
+        t[1] = FE_IB(j);
+        t[2] = FE_IB(j+1);
+        FE_SIDE(1);
+        FE_CHECK(FE_INVERTED(t));
+        FE_LINK(2, na - 1 + j);
+        j++;
+        nt++;
+        FE_FLUSH();
+    }
+
+#if FE_ADJ
+    // The ends of the band
+    if (nt > 0) {
+        nbr[prev] = -1;
+        bnd[na + nb - 2] = 0;
+        bnd[na + nb - 1] = prev;
+    }
+#endif
+
+#if FE_SINK == FE_STREAM
+    // Pass the last block
+    if (nt > base && !sink(ctx, blk, nt - base)) return 0;
+#endif
+    return nt;
+}
+
+#undef FE_NAME
+#undef FE_REPAIR
+#undef FE_REPAIR_PARAMS
+#undef FE_FLOAT
+#undef FE_REAL
+#undef FE_ADJ
+#undef FE_ADJ_PARAMS
+#undef FE_LINK
+#undef FE_INPUT
+#undef FE_INPUT_PARAMS
+#undef FE_IA
+#undef FE_IB
+#undef FE_SINK
+#undef FE_SINK_PARAMS
+#undef FE_TRI
+#undef FE_FLUSH
+#undef FE_CHECK
+#undef FE_SIDE
+#ifdef FE_INVERTED
+#undef FE_INVERTED
+#endif
+
+#endif /* FE_NAME */
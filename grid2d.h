@@ -0,0 +1,356 @@
+#ifndef GRID2D_H
+#define GRID2D_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*-------------------------------------------------------------
+  Shared prototypes of the 2D grid generation kernels
+  -------------------------------------------------------------
+  Each module (offset1.c, triangulate.c, ...) defines its own
+  kernels and the D wrappers that expose them to the interpreter.
+  This header only declares the kernels that are called from
+  other modules, so that drivers can chain them natively.
+
+  Build flags:
+    GRID2D_NO_D     build the kernels without the D wrappers,
+                    for native drivers such as bench.c
+    GRID2D_TRACE    record trace events in build_parallel_curve
+    GRID2D_NO_SIMD  force the scalar offset kernel
+-------------------------------------------------------------*/
+
+/* workspace.c: reusable scratch arena and output buffers */
+typedef struct Grid2DBlock Grid2DBlock;
+
+typedef struct {
+    Grid2DBlock *arena;     // scratch blocks of the current call, newest first
+    double *x0, *y0;        // offset curve output
+    int nxy;                // capacity of x0, y0 in points
+    int *tri;               // triangle output
+    int ntri;               // capacity of tri in triangles
+} Grid2DWork;
+
+#define GRID2D_WORK_INIT { NULL, NULL, NULL, 0, NULL, 0 }
+
+void *grid2d_work_alloc(Grid2DWork *w, size_t bytes);
+void grid2d_work_reset(Grid2DWork *w);
+int grid2d_work_reserve_xy(Grid2DWork *w, int n);
+int grid2d_work_reserve_tri(Grid2DWork *w, int nt);
+void grid2d_work_free(Grid2DWork *w);
+Grid2DWork *grid2d_d_work(void);
+
+/* offset1.c */
+int build_parallel_curve(
+    double *x, double *y, int n,
+    double h,
+    double lmin, double lmax,
+    double *x0, double *y0, int nmax,
+    int trace);
+
+/* Single precision: float coordinates and offset points, filter in
+   double on them (may drift from build_parallel_curve, see offset_engine.h) */
+int build_parallel_curve_f(
+    float *x, float *y, int n,
+    double h,
+    double lmin, double lmax,
+    float *x0, float *y0, int nmax,
+    int trace);
+
+/* Same, with the output in the buffers of w (*x0, *y0 point to them) */
+int build_parallel_curve_ws(
+    Grid2DWork *w,
+    double *x, double *y, int n,
+    double h,
+    double lmin, double lmax,
+    double **x0, double **y0,
+    int trace);
+
+/* Offsets at the distances hl[0..nlay-1] in one pass, layer k in
+   the slot x0 + k*(2n-1) with ml[k] points */
+int build_parallel_multi(
+    double *x, double *y, int n,
+    int nlay, double *hl,
+    double lmin, double lmax,
+    double *x0, double *y0, int *ml);
+
+void parallel_multi_schedule(double h0, double ratio, int count, double *hl);
+
+/* Trace events of build_parallel_curve (compiled with -DGRID2D_TRACE) */
+#define PARALLEL_TRACE_SIZE 4096     // ring buffer length, power of two
+
+enum {
+    PT_START,       // seg = number of input points, m = nmax
+    PT_FOLD,        // offset segment folded back, B not stored
+    PT_SKIP,        // B skipped, AB shorter than lmin
+    PT_INSERT,      // point C inserted, AB longer than lmax
+    PT_APPEND,      // point B appended
+    PT_OVERFLOW,    // output buffer full, routine returns 0
+    PT_END          // m = number of points produced
+};
+
+typedef struct {
+    int kind;       // one of the PT_* codes
+    int seg;        // segment index
+    int m;          // number of output points after the event
+} ParallelTraceEvent;
+
+int parallel_trace_read(ParallelTraceEvent *ev, int max);
+void parallel_trace_clear(void);
+void parallel_trace_print(FILE *f);
+
+/* triangulate.c */
+int fill_between(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri);
+
+/* Same, with the output in the buffer of w (*tri points to it) */
+int fill_between_ws(
+    Grid2DWork *w,
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int **tri);
+
+int fill_between_repair(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int *rep, int *nrep, int *nbad);
+
+int fill_between_range(
+    double *x, double *y,
+    int a0, int sa, int na,
+    int b0, int sb, int nb,
+    int *tri);
+
+/* Single precision: float coordinates, orientation tests in double */
+int fill_between_f(
+    float *x, float *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri);
+
+int fill_between_range_f(
+    float *x, float *y,
+    int a0, int sa, int na,
+    int b0, int sb, int nb,
+    int *tri);
+
+int fill_between_adj(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int *nbr, int *bnd);
+
+/* Receives nt triangles (3 indices each) from fill_between_stream;
+   returns 0 to stop the triangulation */
+typedef int (*FillSink)(void *ctx, const int *tri, int nt);
+
+int fill_between_stream(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *blk, int kblk,
+    FillSink sink, void *ctx);
+
+int fill_between_par(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int nchunk);
+
+/* Same, with the scratch arrays taken from w */
+int fill_between_par_ws(
+    Grid2DWork *w,
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int nchunk);
+
+/* offset_clean.c */
+int remove_self_intersections(double *x, double *y, int n);
+int remove_self_intersections_ws(Grid2DWork *w, double *x, double *y, int n);
+void close_offset_curve(double *x, double *y, int n);
+
+/* offset_batch.c */
+int build_parallel_batch(
+    double *x, double *y, int *off, int ncurves,
+    double h,
+    double lmin, double lmax,
+    double *x0, double *y0, int *off0);
+int parallel_batch_size(const int *off, int ncurves);
+
+/* band_update.c: a band kept for incremental updates */
+typedef struct {
+    int n, m, nt;           // base points, offset points, triangles
+    double *xv, *yv;        // base curve (0 .. n-1), then offset slots (n .. 3n-2)
+    unsigned char *nc;      // nc[i]: offset points emitted by base segment i
+    int *la;                // la[i]: offset vertex A before base segment i
+    int *zb;                // zb[j]: offset vertex where the zip path reaches base vertex j
+    int *tri;               // triangle slots, 3 indices each (-1 if empty)
+    double h, lmin, lmax;   // offset parameters
+} BandState;
+
+#define BAND_STATE_INIT { 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, 0.0, 0.0, 0.0 }
+
+int build_band_state(
+    BandState *s, Grid2DWork *w,
+    double *x, double *y, int n,
+    double h,
+    double lmin, double lmax);
+
+int update_band_state(
+    BandState *s, Grid2DWork *w,
+    double *x, double *y,
+    const int *dirty, int ndirty);
+
+int band_state_triangles(const BandState *s, int *tri);
+void free_band_state(BandState *s);
+
+/* quad_band.c */
+int build_quad_band(
+    double *x, double *y, int n,
+    double h,
+    double lmin, double lmax,
+    double *xv, double *yv,
+    int *quad, int *nq,
+    int *tri, int *nt);
+
+/* reorder.c: renumbering for locality, permutations old -> new */
+enum { REORDER_RCM, REORDER_HILBERT };
+
+int mesh_bandwidth(int k, int ne, const int *el);
+int reorder_rcm(Grid2DWork *w, int nv, int k, int ne, const int *el, int *vperm);
+int reorder_hilbert(Grid2DWork *w, int nv, const double *x, const double *y, int *vperm);
+
+int reorder_mesh(
+    Grid2DWork *w, int method,
+    double *x, double *y, int nv,
+    int k, int *el, int ne,
+    int *vperm, int *eperm);
+
+/* quality.c: edge-flip pass, smallest-angle histograms */
+enum { FLIP_DELAUNAY, FLIP_MIN_ANGLE };
+#define QUALITY_BINS 12              // 5 degree bins, 0 to 60
+
+void quality_histogram(const double *x, const double *y, const int *tri, int nt, int *hist);
+int triangle_adjacency(Grid2DWork *w, const int *tri, int nt, int nv, int *nbr);
+
+int improve_quality(
+    Grid2DWork *w,
+    double *x, double *y,
+    int *tri, int nt,
+    int method,
+    int *hist0, int *hist1);
+
+/* distance.c: signed distance field on a grid, level lines */
+int curve_distance_field(
+    Grid2DWork *w,
+    double *x, double *y, int n,
+    double x0, double y0, double dx,
+    int nx, int ny,
+    int band,
+    double *phi);
+
+int distance_contour(
+    Grid2DWork *w,
+    const double *phi,
+    double x0, double y0, double dx,
+    int nx, int ny,
+    double h,
+    double **cx, double **cy,
+    int **off);
+
+/* locate.c: point location in a triangulation */
+typedef struct {
+    int nt;                 // triangles, in Morton order of their centroids
+    double *tc;             // vertex coordinates of each triangle, x0 y0 x1 y1 x2 y2
+    signed char *sg;        // orientation of each triangle (+1, -1, 0 if flat)
+    int *id;                // id[k]: index of triangle k in the input
+    int *nbr;               // half-edge adjacency in this order, or NULL
+    int gx, gy;             // cells of the bucket grid per axis
+    double x0, y0, inv;     // grid origin and inverse cell size
+    int *start, *cell;      // triangles of cell c: cell[start[c] .. start[c+1]-1]
+} Locator;
+
+#define LOCATOR_INIT { 0, NULL, NULL, NULL, NULL, 0, 0, 0.0, 0.0, 0.0, NULL, NULL }
+
+int build_locator(
+    Locator *L, Grid2DWork *w,
+    const double *x, const double *y,
+    const int *tri, int nt,
+    const int *nbr);
+
+int locate_points(
+    const Locator *L, Grid2DWork *w,
+    const double *qx, const double *qy, int nq,
+    int *tid, double *bary);
+
+void free_locator(Locator *L);
+
+/* meshfile.c: binary mesh container, streaming writer, mapped reader */
+#define MESH_FILE_VERSION 1
+enum { MESH_VERT = 1, MESH_TRI, MESH_QUAD, MESH_NBR3, MESH_NBR4 };   // chunk types
+enum { MESH_VTK, MESH_GMSH };                                        // export formats
+
+typedef struct MeshEntry MeshEntry;
+
+typedef struct {
+    FILE *f;                // output file
+    int64_t off;            // bytes written
+    MeshEntry *toc;         // chunks written so far
+    int nchunk, cap;        // their number, capacity of toc
+    int open;               // the last chunk can still grow
+    int ok;                 // no write error so far
+    int band;               // band of the triangles given to mesh_writer_sink
+} MeshWriter;
+
+#define MESH_WRITER_INIT { NULL, 0, NULL, 0, 0, 0, 0, 0 }
+
+typedef struct {
+    int type, tag;          // chunk type, layer (vertices) or band (elements)
+    int64_t n;              // vertices or elements
+    const void *data;       // payload, inside the mapping
+} MeshChunk;
+
+typedef struct {
+    void *map;              // mapped file
+    size_t size;            // its size in bytes
+    MeshChunk *chunk;       // chunks, in file order
+    int nchunk;
+    int64_t nv, ntri, nquad; // vertices, triangles and quads in the file
+} MeshFile;
+
+#define MESH_FILE_INIT { NULL, 0, NULL, 0, 0, 0, 0 }
+
+int mesh_writer_open(MeshWriter *mw, const char *path);
+int mesh_write_vertices(MeshWriter *mw, const double *x, const double *y, int n, int layer);
+int mesh_write_elements(MeshWriter *mw, int type, const int *el, int ne, int band);
+int mesh_writer_sink(void *ctx, const int *tri, int nt);
+int mesh_writer_close(MeshWriter *mw);
+
+int mesh_file_open(MeshFile *mf, const char *path);
+int64_t mesh_file_vertices(const MeshFile *mf, double *x, double *y, int *layer);
+int64_t mesh_file_elements(const MeshFile *mf, int type, int *el, int *band);
+int mesh_file_export(const MeshFile *mf, const char *path, int format);
+void mesh_file_close(MeshFile *mf);
+
+/* band_layers.c */
+int build_band_layers(
+    double *x, double *y, int n,
+    int nlayers, double *thick,
+    double lmin, double lmax,
+    double **xv, double **yv, int **lay,
+    int **tri, int *nt);
+
+int build_band_layers_adj(
+    double *x, double *y, int n,
+    int nlayers, double *thick,
+    double lmin, double lmax,
+    double **xv, double **yv, int **lay,
+    int **tri, int *nt,
+    int **nbr, int **bnd, int *nbnd);
+
+#endif
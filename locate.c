@@ -0,0 +1,541 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+#include "predicates.h"
+
+/*-------------------------------------------------------------
+  Point location in a triangulation
+  -------------------------------------------------------------
+  A Locator indexes the triangles of a mesh (the output of
+  fill_between, build_band_layers, ...) for point queries:
+
+  - Bucket grid: a uniform grid of square cells over the box of
+    the mesh, each cell listing (CSR) the triangles whose box
+    overlaps it. The cell size is chosen from the boxes of the
+    triangles so that the lists hold about LOCATE_FILL entries
+    per triangle in total, whatever their shape: a triangle of
+    box w by h lands in (w/c + 1)(h/c + 1) cells, and the sum of
+    that over the triangles is a quadratic in 1/c. The slivers
+    of a thin band give larger cells than a mesh of the same
+    area with well-shaped triangles, so the memory stays linear.
+    The number of cells is capped at LOCATE_FILL per triangle as
+    well, for a band in a box it only fills a little of.
+  - Walk: with the half-edge adjacency (nbr[3t+k] = 3s+l, as
+    built by fill_between_adj or triangle_adjacency), a query
+    starts from the triangle of the previous one and crosses, at
+    each step, an edge that has the point on its outer side. The
+    walk is cut after LOCATE_WALK steps, or when it leaves the
+    mesh (a band is not convex), and the query then falls back to
+    the list of its cell. The slivers of a thin band (segments
+    much shorter than the thickness) fill every cell they cross
+    with hundreds of triangles, so there the walk does most of
+    the work; a point just outside such a band still pays for the
+    scan of its cell.
+
+  locate_points answers a batch of queries: they are sorted by
+  Morton code of their position, so that consecutive queries are
+  close in the plane and the walk from the previous one is short,
+  and the sorted queries are split among the threads with
+  OpenMP, each thread walking from its own previous answer. The
+  locator stores the triangles in Morton order of their
+  centroids as well, with their vertex coordinates next to each
+  other, so that a batch goes through the mesh almost
+  sequentially instead of jumping from triangle to vertex to
+  triangle.
+
+  All the tests are orient2d signs, exact, so a point on an edge
+  shared by two triangles is found in one of them, never in
+  neither. They are first evaluated in plain double precision
+  against the error bound of orient2d, and only the doubtful
+  ones are computed again exactly. The barycentric coordinates
+  are the three signed areas divided by their sum: bary[3q+k] is
+  the weight of vertex tri[3t+k] of the triangle t found for
+  query q.
+
+  The locator keeps its own copy of what it needs of the mesh,
+  allocated with malloc and released with free_locator. The
+  sorts take their scratch arrays from the arena of a workspace
+  (see workspace.c).
+-------------------------------------------------------------*/
+
+#define LOCATE_FILL 4          // cell list entries, and cells, per triangle
+#define LOCATE_WALK 256        // steps of a walk before the cell fallback
+
+/*-------------------------------------------------------------
+  Helper: the three edge determinants of triangle t against
+  (px, py), in plain double precision and signed by the
+  orientation of t (d[k] >= 0 on the inner side of the edge
+  opposite vertex k), with their error bounds e[k] (those of
+  orient2d: a determinant larger than its bound has the right
+  sign)
+-------------------------------------------------------------*/
+static inline void locate_dets(const Locator *L, int t, double px, double py,
+                               double *d, double *e) {
+    const double *c = L->tc + 6 * (size_t)t;
+    double s = L->sg[t];
+    for (int k = 0; k < 3; k++) {
+        int a = 2 * (k == 2 ? 0 : k + 1), b = 2 * (k == 0 ? 2 : k - 1);
+        double l = (c[b] - c[a]) * (py - c[a+1]);
+        double r = (c[b+1] - c[a+1]) * (px - c[a]);
+        d[k] = s * (l - r);
+        e[k] = PRED_ERRBOUND * (fabs(l) + fabs(r));
+    }
+}
+
+/*-------------------------------------------------------------
+  Helper: replace the doubtful determinants by exact ones
+-------------------------------------------------------------*/
+static void locate_exact(const Locator *L, int t, double px, double py,
+                         double *d, const double *e) {
+    const double *c = L->tc + 6 * (size_t)t;
+    for (int k = 0; k < 3; k++) {
+        if (fabs(d[k]) > e[k]) continue;
+        int a = 2 * (k == 2 ? 0 : k + 1), b = 2 * (k == 0 ? 2 : k - 1);
+        d[k] = L->sg[t] * orient2d(c[a], c[a+1], c[b], c[b+1], px, py);
+    }
+}
+
+/*-------------------------------------------------------------
+  Helper: barycentric coordinates from the edge determinants
+-------------------------------------------------------------*/
+static inline void locate_bary(const double *d, double *b) {
+    double sum = d[0] + d[1] + d[2];
+    b[0] = d[0] / sum;
+    b[1] = d[1] / sum;
+    b[2] = d[2] / sum;
+}
+
+/*-------------------------------------------------------------
+  Helper: is (px, py) in triangle t? If so, its barycentric
+  coordinates go to b[0..2].
+-------------------------------------------------------------*/
+static int locate_in_triangle(const Locator *L, int t, double px, double py, double *b) {
+    if (!L->sg[t]) return 0;
+    double d[3], e[3];
+    locate_dets(L, t, px, py, d, e);
+    // Certainly outside, the common case, without branching on
+    // each edge
+    if ((d[0] < -e[0]) | (d[1] < -e[1]) | (d[2] < -e[2])) return 0;
+    if ((d[0] <= e[0]) | (d[1] <= e[1]) | (d[2] <= e[2])) {
+        locate_exact(L, t, px, py, d, e);
+        if (d[0] < 0.0 || d[1] < 0.0 || d[2] < 0.0) return 0;
+    }
+    locate_bary(d, b);
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Helper: cell of (px, py), or -1 outside the grid
+-------------------------------------------------------------*/
+static int locate_cell(const Locator *L, double px, double py) {
+    double fx = (px - L->x0) * L->inv, fy = (py - L->y0) * L->inv;
+    if (!(fx >= 0.0 && fy >= 0.0)) return -1;
+    int i = fx < L->gx ? (int)fx : L->gx, j = fy < L->gy ? (int)fy : L->gy;
+    if (i >= L->gx || j >= L->gy) return -1;
+    return j * L->gx + i;
+}
+
+/*-------------------------------------------------------------
+  Helper: one query, walking from triangle t (or -1 for none)
+  Returns the triangle found, or -1.
+-------------------------------------------------------------*/
+static int locate_one(const Locator *L, int t, double px, double py, double *b) {
+    if (L->nbr) {
+        for (int step = 0; t >= 0 && step < LOCATE_WALK; step++) {
+            if (!L->sg[t]) break;
+            double d[3], e[3];
+            locate_dets(L, t, px, py, d, e);
+            if ((d[0] <= e[0]) | (d[1] <= e[1]) | (d[2] <= e[2]))
+                locate_exact(L, t, px, py, d, e);
+            // Cross an edge with the point outside, starting from a
+            // different edge at each step so that the walk cannot
+            // cycle on a poorly shaped mesh
+            int k0 = step % 3, k = -1;
+            for (int r = 0; r < 3; r++) {
+                int kr = k0 + r < 3 ? k0 + r : k0 + r - 3;
+                if (d[kr] < 0.0) { k = kr; break; }
+            }
+            if (k < 0) {
+                locate_bary(d, b);
+                return t;
+            }
+            // d[k] is the edge opposite vertex k, edge k+1 of t
+            int h = L->nbr[3 * t + (k == 2 ? 0 : k + 1)];
+            t = h >= 0 ? h / 3 : -1;
+        }
+    }
+
+    int c = locate_cell(L, px, py);
+    if (c < 0) return -1;
+    for (int q = L->start[c]; q < L->start[c+1]; q++)
+        if (locate_in_triangle(L, L->cell[q], px, py, b)) return L->cell[q];
+    return -1;
+}
+
+/*-------------------------------------------------------------
+  Helper: Morton code of a 16-bit cell, x bits even
+-------------------------------------------------------------*/
+static uint32_t morton_spread(uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+/*-------------------------------------------------------------
+  Helper: Morton code of (px, py) on the box of the grid, cut in
+  65536 x 65536 (points outside are clamped to it)
+-------------------------------------------------------------*/
+static inline uint32_t locate_key(const Locator *L, double px, double py) {
+    double sc = 65535.0 * L->inv / (L->gx > L->gy ? L->gx : L->gy);
+    double fx = (px - L->x0) * sc, fy = (py - L->y0) * sc;
+    uint32_t i = fx > 0.0 ? (fx < 65535.0 ? (uint32_t)fx : 65535u) : 0u;
+    uint32_t j = fy > 0.0 ? (fy < 65535.0 ? (uint32_t)fy : 65535u) : 0u;
+    return morton_spread(i) | (morton_spread(j) << 1);
+}
+
+/*-------------------------------------------------------------
+  Helper: LSD radix sort of the ids id[0..n-1] by their keys,
+  8 bits per pass, stable. key and id have room for 2n entries;
+  returns the half of id that holds the sorted ids.
+-------------------------------------------------------------*/
+static int *locate_sort(uint32_t *key, int *id, int n) {
+    uint32_t *ka = key, *kb = key + n;
+    int *ia = id, *ib = id + n;
+    for (int sh = 0; sh < 32; sh += 8) {
+        int cnt[257] = { 0 };
+        for (int q = 0; q < n; q++) cnt[((ka[q] >> sh) & 0xff) + 1]++;
+        for (int b = 0; b < 256; b++) cnt[b+1] += cnt[b];
+        for (int q = 0; q < n; q++) {
+            int p = cnt[(ka[q] >> sh) & 0xff]++;
+            kb[p] = ka[q];
+            ib[p] = ia[q];
+        }
+        uint32_t *kt = ka; ka = kb; kb = kt;
+        int *it = ia; ia = ib; ib = it;
+    }
+    return ia;
+}
+
+/*-------------------------------------------------------------
+  Build the index of the triangles tri (nt, 3 vertex indices
+  each) over the vertices x, y. nbr is the half-edge adjacency
+  (3 entries per triangle), or NULL to locate with the bucket
+  grid alone. The locator keeps its own copy of the triangles,
+  in Morton order of their centroids, so that the queries (in
+  the same order) go through them almost sequentially.
+  Scratch memory is taken from w.
+  Returns 1, or 0 if out of memory (L is then empty).
+-------------------------------------------------------------*/
+int build_locator(
+    Locator *L, Grid2DWork *w,
+    const double *x, const double *y,  // Vertices
+    const int *tri, int nt,            // Triangles
+    const int *nbr                     // Adjacency, or NULL
+) {
+    free_locator(L);
+    if (nt < 1) return 1;
+    grid2d_work_reset(w);
+    uint32_t *key = grid2d_work_alloc(w, 2 * (size_t)nt * sizeof(uint32_t));
+    int *id = grid2d_work_alloc(w, 2 * (size_t)nt * sizeof(int));
+    int *inv = nbr ? grid2d_work_alloc(w, nt * sizeof(int)) : NULL;
+    L->tc = malloc(6 * (size_t)nt * sizeof(double));
+    L->sg = malloc(nt);
+    L->id = malloc(nt * sizeof(int));
+    if (nbr) L->nbr = malloc(3 * (size_t)nt * sizeof(int));
+    if (!key || !id || (nbr && !inv) || !L->tc || !L->sg || !L->id || (nbr && !L->nbr)) {
+        free_locator(L);
+        return 0;
+    }
+
+    /* ---- Box of the mesh, sums over the boxes of the triangles ---- */
+    double xmin = x[tri[0]], xmax = xmin, ymin = y[tri[0]], ymax = ymin;
+    double sa = 0.0, sp = 0.0;       // sum of w*h, sum of w+h
+    for (int t = 0; t < nt; t++) {
+        const int *v = tri + 3 * t;
+        double ax = fmin(x[v[0]], fmin(x[v[1]], x[v[2]])), bx = fmax(x[v[0]], fmax(x[v[1]], x[v[2]]));
+        double ay = fmin(y[v[0]], fmin(y[v[1]], y[v[2]])), by = fmax(y[v[0]], fmax(y[v[1]], y[v[2]]));
+        if (ax < xmin) xmin = ax;
+        if (bx > xmax) xmax = bx;
+        if (ay < ymin) ymin = ay;
+        if (by > ymax) ymax = by;
+        sa += (bx - ax) * (by - ay);
+        sp += (bx - ax) + (by - ay);
+    }
+
+    /* ---- Cell size: sa u^2 + sp u + nt = LOCATE_FILL nt, u = 1/c,
+       with at most LOCATE_FILL nt cells ---- */
+    double ex = xmax - xmin, ey = ymax - ymin, e = (double)(LOCATE_FILL - 1) * nt;
+    double u = sa > 0.0 ? (sqrt(sp * sp + 4.0 * sa * e) - sp) / (2.0 * sa) :
+               sp > 0.0 ? e / sp : 1.0;
+    double ucap = ex * ey > 0.0 ? sqrt((double)LOCATE_FILL * nt / (ex * ey)) :
+                  ex + ey > 0.0 ? (double)LOCATE_FILL * nt / (ex + ey) : 1.0;
+    if (u > ucap) u = ucap;
+    L->gx = (int)(ex * u) + 1;
+    L->gy = (int)(ey * u) + 1;
+    L->x0 = xmin;
+    L->y0 = ymin;
+    L->inv = u;
+    L->nt = nt;
+    size_t nc = (size_t)L->gx * L->gy;
+
+    /* ---- Triangles in Morton order of their centroids ---- */
+    for (int t = 0; t < nt; t++) {
+        const int *v = tri + 3 * t;
+        key[t] = locate_key(L, (x[v[0]] + x[v[1]] + x[v[2]]) / 3.0,
+                               (y[v[0]] + y[v[1]] + y[v[2]]) / 3.0);
+        id[t] = t;
+    }
+    int *ord = locate_sort(key, id, nt);
+    for (int k = 0; k < nt; k++) {
+        int t = ord[k];
+        const int *v = tri + 3 * t;
+        double *c = L->tc + 6 * (size_t)k;
+        for (int l = 0; l < 3; l++) {
+            c[2*l] = x[v[l]];
+            c[2*l+1] = y[v[l]];
+        }
+        double o = orient2d(c[0], c[1], c[2], c[3], c[4], c[5]);
+        L->sg[k] = o > 0.0 ? 1 : o < 0.0 ? -1 : 0;
+        L->id[k] = t;
+        if (inv) inv[t] = k;
+    }
+    if (nbr) {
+        for (int k = 0; k < nt; k++)
+            for (int l = 0; l < 3; l++) {
+                int h = nbr[3 * L->id[k] + l];
+                L->nbr[3*k+l] = h >= 0 ? 3 * inv[h / 3] + h % 3 : -1;
+            }
+    }
+
+    /* ---- Cell lists (CSR), triangles in increasing order ---- */
+    L->start = malloc((nc + 1) * sizeof(int));
+    if (!L->start) {
+        free_locator(L);
+        return 0;
+    }
+    memset(L->start, 0, (nc + 1) * sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int k = 0; k < nt; k++) {
+            const double *c = L->tc + 6 * (size_t)k;
+            double ax = fmin(c[0], fmin(c[2], c[4])), bx = fmax(c[0], fmax(c[2], c[4]));
+            double ay = fmin(c[1], fmin(c[3], c[5])), by = fmax(c[1], fmax(c[3], c[5]));
+            int i0 = (int)((ax - xmin) * u), i1 = (int)((bx - xmin) * u);
+            int j0 = (int)((ay - ymin) * u), j1 = (int)((by - ymin) * u);
+            if (i1 >= L->gx) i1 = L->gx - 1;
+            if (j1 >= L->gy) j1 = L->gy - 1;
+            for (int j = j0; j <= j1; j++)
+                for (int i = i0; i <= i1; i++) {
+                    size_t q = (size_t)j * L->gx + i;
+                    if (pass == 0) L->start[q+1]++;
+                    else L->cell[L->start[q]++] = k;
+                }
+        }
+        if (pass == 0) {
+            for (size_t q = 0; q < nc; q++) L->start[q+1] += L->start[q];
+            L->cell = malloc((size_t)L->start[nc] * sizeof(int));
+            if (!L->cell) {
+                free_locator(L);
+                return 0;
+            }
+        } else {
+            for (size_t q = nc; q > 0; q--) L->start[q] = L->start[q-1];
+            L->start[0] = 0;
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Locate the nq points (qx[q], qy[q]): tid[q] receives the
+  triangle that holds point q, or -1 if it is outside the mesh,
+  and bary[3q..3q+2] its barycentric coordinates (zero outside).
+  Scratch memory is taken from w.
+  Returns the number of points found, or -1 if out of memory.
+-------------------------------------------------------------*/
+int locate_points(
+    const Locator *L, Grid2DWork *w,
+    const double *qx, const double *qy, int nq,  // Query points
+    int *tid, double *bary                       // Output
+) {
+    if (nq < 1) return 0;
+    if (L->nt < 1) {
+        for (int q = 0; q < nq; q++) tid[q] = -1;
+        memset(bary, 0, 3 * (size_t)nq * sizeof(double));
+        return 0;
+    }
+    grid2d_work_reset(w);
+    uint32_t *key = grid2d_work_alloc(w, 2 * (size_t)nq * sizeof(uint32_t));
+    int *id = grid2d_work_alloc(w, 2 * (size_t)nq * sizeof(int));
+    if (!key || !id) return -1;
+
+    /* ---- Morton order of the queries ---- */
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < nq; q++) {
+        key[q] = locate_key(L, qx[q], qy[q]);
+        id[q] = q;
+    }
+    int *ia = locate_sort(key, id, nq);
+    int *st = ia == id ? id + nq : id;
+
+    /* ---- Queries in Morton order, each thread walking from
+       its previous answer. The points are gathered in that order
+       and the answers scattered back in separate passes, so that
+       the walks run over contiguous arrays ---- */
+    double *sx = grid2d_work_alloc(w, 2 * (size_t)nq * sizeof(double));
+    double *sb = grid2d_work_alloc(w, 3 * (size_t)nq * sizeof(double));
+    if (!sx || !sb) return -1;
+    double *sy = sx + nq;
+    int found = 0;
+    #pragma omp parallel reduction(+:found)
+    {
+        #pragma omp for schedule(static)
+        for (int k = 0; k < nq; k++) {
+            sx[k] = qx[ia[k]];
+            sy[k] = qy[ia[k]];
+        }
+        int t = -1;
+        #pragma omp for schedule(static)
+        for (int k = 0; k < nq; k++) {
+            double *b = sb + 3 * (size_t)k;
+            int r = locate_one(L, t, sx[k], sy[k], b);
+            st[k] = r;
+            if (r >= 0) {
+                t = r;
+                found++;
+            } else {
+                b[0] = b[1] = b[2] = 0.0;
+            }
+        }
+        #pragma omp for schedule(static)
+        for (int k = 0; k < nq; k++) {
+            int q = ia[k];
+            tid[q] = st[k] >= 0 ? L->id[st[k]] : -1;
+            memcpy(bary + 3 * (size_t)q, sb + 3 * (size_t)k, 3 * sizeof(double));
+        }
+    }
+    return found;
+}
+
+/*-------------------------------------------------------------
+  Free the buffers of a locator and leave it empty
+-------------------------------------------------------------*/
+void free_locator(Locator *L) {
+    free(L->tc);
+    free(L->sg);
+    free(L->id);
+    free(L->nbr);
+    free(L->start);
+    free(L->cell);
+    *L = (Locator)LOCATOR_INIT;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for batched point location
+  Inputs (D*):
+    x, y   : double arrays with the vertex coordinates
+    tri    : integer array with the triangles, 3 indices each
+    nbr    : integer array with the half-edge adjacency (3 per
+             triangle, as returned by fill_between_adj), or an
+             empty array to use the bucket grid alone
+    qx, qy : double arrays with the query points
+  Returns: D list with the triangle of each query (-1 outside)
+  and the barycentric coordinates (3 per query), or DCreaNulo()
+  on error
+-------------------------------------------------------------*/
+D *_locate_points6(D *x, D *y, D *tri, D *nbr, D *qx, D *qy) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(nbr);
+        DLibera(qx);
+        DLibera(qy);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        tri->t != D_TIPO_INT || nbr->t != D_TIPO_INT ||
+        qx->t != D_TIPO_DOUBLE || qy->t != D_TIPO_DOUBLE) {
+        DError("locate_points : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(nbr);
+        DLibera(qx);
+        DLibera(qy);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || tri->n % 3 != 0 || qx->n != qy->n ||
+        (nbr->n != 0 && nbr->n != tri->n)) {
+        DError("locate_points : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(nbr);
+        DLibera(qx);
+        DLibera(qy);
+        return DCreaNulo();
+    }
+
+    // Check the vertex and half-edge indices
+    int bad = 0;
+    for (int q = 0; q < tri->n; q++)
+        if (tri->p.i[q] < 0 || tri->p.i[q] >= x->n) bad = 1;
+    for (int q = 0; q < nbr->n; q++)
+        if (nbr->p.i[q] < -1 || nbr->p.i[q] >= tri->n) bad = 1;
+    if (bad) {
+        DError("locate_points : index out of range");
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(nbr);
+        DLibera(qx);
+        DLibera(qy);
+        return DCreaNulo();
+    }
+
+    Locator L = LOCATOR_INIT;
+    D *dt = DCreaInt(qx->n);
+    D *db = DCreaDouble(3 * qx->n);
+    Grid2DWork *w = grid2d_d_work();
+    int r = -1;
+    if (build_locator(&L, w, x->p.d, y->p.d, tri->p.i, tri->n / 3, nbr->n ? nbr->p.i : NULL))
+        r = locate_points(&L, w, qx->p.d, qy->p.d, qx->n, dt->p.i, db->p.d);
+    free_locator(&L);
+
+    D *output;
+    if (r >= 0) {
+        output = DCreaLista();
+        DInserta(output, dt);
+        DInserta(output, db);
+    } else {
+        DLibera(dt);
+        DLibera(db);
+        output = DCreaNulo();
+    }
+
+    DLibera(x);
+    DLibera(y);
+    DLibera(tri);
+    DLibera(nbr);
+    DLibera(qx);
+    DLibera(qy);
+    return output;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*-------------------------------------------------------------
+  Convert a mesh file (meshfile.c) for inspection
+  -------------------------------------------------------------
+  Writes the mesh as a legacy VTK unstructured grid (.vtk, for
+  ParaView) or a Gmsh 2.2 mesh (.msh), chosen by the extension
+  of the output, and prints the chunks of the file.
+
+  Build and run:
+    gcc -O2 -o mesh_convert mesh_convert.c
+    ./mesh_convert mesh.g2m out.vtk
+-------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "meshfile.c"
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s mesh.g2m out.vtk|out.msh\n", argv[0]);
+        return 1;
+    }
+    const char *ext = strrchr(argv[2], '.');
+    int format = ext && !strcmp(ext, ".msh") ? MESH_GMSH : MESH_VTK;
+
+    MeshFile mf;
+    if (!mesh_file_open(&mf, argv[1])) {
+        fprintf(stderr, "%s: not a mesh file\n", argv[1]);
+        return 1;
+    }
+    static const char *kind[] = { "", "vertices", "triangles", "quads", "adjacency", "adjacency" };
+    for (int c = 0; c < mf.nchunk; c++)
+        printf("%4d  %-10s tag %4d  %lld\n", c, kind[mf.chunk[c].type], mf.chunk[c].tag,
+               (long long)mf.chunk[c].n);
+    printf("%lld vertices, %lld triangles, %lld quads\n",
+           (long long)mf.nv, (long long)mf.ntri, (long long)mf.nquad);
+
+    int ok = mesh_file_export(&mf, argv[2], format);
+    mesh_file_close(&mf);
+    if (!ok) {
+        fprintf(stderr, "%s: cannot write\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Binary mesh container
+  -------------------------------------------------------------
+  A mesh file is a sequence of chunks, each one an array of a
+  single kind tagged with an integer:
+
+    MESH_VERT   vertices: x[0..n-1], then y[0..n-1];
+                tag = layer
+    MESH_TRI    triangles, 3 vertex indices each; tag = band
+    MESH_QUAD   quads, 4 vertex indices each; tag = band
+    MESH_NBR3   half-edge adjacency of triangles, 3 entries each
+                (nbr[3t+k] = 3s+l, -1 on the boundary); tag = band
+    MESH_NBR4   the same for quads, 4 entries each
+
+  The vertices are numbered across the MESH_VERT chunks in file
+  order, and the elements across the element chunks, so a layered
+  band is written one layer (vertices) and one band (triangles)
+  at a time, with the shared numbering of build_band_layers.
+
+  Layout (native byte order, every offset a multiple of 8):
+
+    header   "GRID2DMF", version, byte order mark 0x01020304,
+             number of chunks, offset of the table (32 bytes)
+    chunks   type, tag, n (16 bytes), then the payload, padded
+             to 8 bytes
+    table    type, tag, n and offset of every chunk (24 bytes
+             each)
+
+  Writer: the chunks are streamed to the file as the mesher hands
+  over its blocks (mesh_writer_sink plugs it into
+  fill_between_stream), through a large stdio buffer. Consecutive
+  blocks of the same kind and tag are merged into one chunk, by
+  patching its count when the chunk is closed, so a band streamed
+  in blocks still reads as one contiguous array. The table and
+  the header counts are written by mesh_writer_close; a file
+  whose writer did not close has none, and is read by walking
+  the chunk headers, up to the last chunk that was closed.
+
+  Reader: mesh_file_open maps the file and only reads the header
+  and the table, so opening does not depend on the size of the
+  mesh: the pages of the arrays are read when they are first
+  touched. chunk[c].data points into the mapping (zero copy);
+  mesh_file_vertices and mesh_file_elements gather the chunks of
+  one kind into caller arrays when a single array is needed.
+
+  mesh_file_export writes a mapped mesh as a legacy VTK
+  unstructured grid (band as cell data, layer as point data) or
+  as a Gmsh 2.2 mesh (physical and elementary tag = band + 1,
+  Gmsh numbers its entities from 1), both in ASCII, for
+  inspection in ParaView or Gmsh.
+-------------------------------------------------------------*/
+
+#define MESH_MAGIC "GRID2DMF"
+#define MESH_BOM 0x01020304u
+#define MESH_HEAD 32           // bytes of the file header
+#define MESH_CHUNK_HEAD 16     // bytes of a chunk header
+#define MESH_BUFFER (1 << 20)  // stdio buffer of the writer
+
+struct MeshEntry {
+    int type, tag;
+    int64_t n, off;            // items, offset of the chunk header
+};
+
+/*-------------------------------------------------------------
+  Helper: bytes of one item of a chunk type, or 0 if unknown
+-------------------------------------------------------------*/
+static size_t mesh_item(int type) {
+    switch (type) {
+    case MESH_VERT: return 2 * sizeof(double);
+    case MESH_TRI:
+    case MESH_NBR3: return 3 * sizeof(int32_t);
+    case MESH_QUAD:
+    case MESH_NBR4: return 4 * sizeof(int32_t);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------
+  Helper: write bytes, keeping track of the offset and errors
+-------------------------------------------------------------*/
+static void mesh_put(MeshWriter *mw, const void *p, size_t bytes) {
+    if (!mw->ok) return;
+    if (bytes && fwrite(p, 1, bytes, mw->f) != bytes) mw->ok = 0;
+    mw->off += bytes;
+}
+
+/*-------------------------------------------------------------
+  Helper: close the open chunk: pad it and patch its count
+-------------------------------------------------------------*/
+static void mesh_end_chunk(MeshWriter *mw) {
+    if (!mw->open) return;
+    static const char zero[8] = { 0 };
+    MeshEntry *e = mw->toc + mw->nchunk - 1;
+    mesh_put(mw, zero, (size_t)(-mw->off & 7));
+    if (mw->ok && (fseeko(mw->f, (off_t)e->off + 8, SEEK_SET) != 0 ||
+                   fwrite(&e->n, sizeof(int64_t), 1, mw->f) != 1 ||
+                   fseeko(mw->f, (off_t)mw->off, SEEK_SET) != 0))
+        mw->ok = 0;
+    mw->open = 0;
+}
+
+/*-------------------------------------------------------------
+  Helper: append n items of a type to the file, in the open
+  chunk if it has the same type and tag, else in a new one
+-------------------------------------------------------------*/
+static int mesh_append(MeshWriter *mw, int type, int tag,
+                       const void *p, size_t bytes, int64_t n) {
+    if (!mw->ok) return 0;
+    MeshEntry *e = mw->nchunk > 0 ? mw->toc + mw->nchunk - 1 : NULL;
+    if (!mw->open || e->type != type || e->tag != tag) {
+        mesh_end_chunk(mw);
+        if (mw->nchunk == mw->cap) {
+            int c = mw->cap > 0 ? 2 * mw->cap : 64;
+            MeshEntry *q = realloc(mw->toc, c * sizeof(MeshEntry));
+            if (!q) {
+                mw->ok = 0;
+                return 0;
+            }
+            mw->toc = q;
+            mw->cap = c;
+        }
+        e = mw->toc + mw->nchunk++;
+        e->type = type;
+        e->tag = tag;
+        e->n = 0;
+        e->off = mw->off;
+        int32_t h[4] = { type, tag, 0, 0 };  // n patched by mesh_end_chunk
+        mesh_put(mw, h, sizeof(h));
+        mw->open = 1;
+    }
+    mesh_put(mw, p, bytes);
+    e->n += n;
+    return mw->ok;
+}
+
+/*-------------------------------------------------------------
+  Start a mesh file (an existing file is replaced)
+  Returns 1, or 0 if the file cannot be created.
+-------------------------------------------------------------*/
+int mesh_writer_open(MeshWriter *mw, const char *path) {
+    *mw = (MeshWriter)MESH_WRITER_INIT;
+    mw->f = fopen(path, "wb");
+    if (!mw->f) return 0;
+    setvbuf(mw->f, NULL, _IOFBF, MESH_BUFFER);
+    mw->ok = 1;
+
+    // Header without table, written again by mesh_writer_close
+    char head[MESH_HEAD] = { 0 };
+    uint32_t ver = MESH_FILE_VERSION, bom = MESH_BOM;
+    memcpy(head, MESH_MAGIC, 8);
+    memcpy(head + 8, &ver, 4);
+    memcpy(head + 12, &bom, 4);
+    mesh_put(mw, head, sizeof(head));
+    return mw->ok;
+}
+
+/*-------------------------------------------------------------
+  Append n vertices of a layer. The x and y of one block are
+  stored one after the other, so a block is never merged with
+  the next one.
+  Returns 1, or 0 on a write error.
+-------------------------------------------------------------*/
+int mesh_write_vertices(MeshWriter *mw, const double *x, const double *y, int n, int layer) {
+    if (n < 1) return mw->ok;
+    mesh_end_chunk(mw);
+    if (!mesh_append(mw, MESH_VERT, layer, x, n * sizeof(double), n)) return 0;
+    mesh_put(mw, y, n * sizeof(double));
+    mesh_end_chunk(mw);
+    return mw->ok;
+}
+
+/*-------------------------------------------------------------
+  Append ne elements (MESH_TRI, MESH_QUAD) or their adjacency
+  (MESH_NBR3, MESH_NBR4) to band
+  Returns 1, or 0 on a write error or an unknown type.
+-------------------------------------------------------------*/
+int mesh_write_elements(MeshWriter *mw, int type, const int *el, int ne, int band) {
+    size_t item = type == MESH_VERT ? 0 : mesh_item(type);
+    if (!item) return 0;
+    if (ne < 1) return mw->ok;
+    return mesh_append(mw, type, band, el, ne * item, ne);
+}
+
+/*-------------------------------------------------------------
+  FillSink that appends the triangles to band mw->band
+-------------------------------------------------------------*/
+int mesh_writer_sink(void *ctx, const int *tri, int nt) {
+    MeshWriter *mw = ctx;
+    return mesh_write_elements(mw, MESH_TRI, tri, nt, mw->band);
+}
+
+/*-------------------------------------------------------------
+  Write the table and the header, and close the file
+  Returns 1 if the whole file was written, else 0.
+-------------------------------------------------------------*/
+int mesh_writer_close(MeshWriter *mw) {
+    if (!mw->f) return 0;
+    mesh_end_chunk(mw);
+    int64_t toc = mw->off, nc = mw->nchunk;
+    for (int c = 0; c < mw->nchunk; c++) {
+        const MeshEntry *e = mw->toc + c;
+        int32_t h[2] = { e->type, e->tag };
+        int64_t v[2] = { e->n, e->off };
+        mesh_put(mw, h, sizeof(h));
+        mesh_put(mw, v, sizeof(v));
+    }
+    if (mw->ok && (fseeko(mw->f, 16, SEEK_SET) != 0 ||
+                   fwrite(&nc, sizeof(int64_t), 1, mw->f) != 1 ||
+                   fwrite(&toc, sizeof(int64_t), 1, mw->f) != 1))
+        mw->ok = 0;
+    if (fclose(mw->f) != 0) mw->ok = 0;
+    int ok = mw->ok;
+    free(mw->toc);
+    *mw = (MeshWriter)MESH_WRITER_INIT;
+    return ok;
+}
+
+/*-------------------------------------------------------------
+  Helper: add a chunk to the table of a mapped file, after
+  checking that it lies inside it
+-------------------------------------------------------------*/
+static int mesh_add_chunk(MeshFile *mf, int cap, int type, int tag, int64_t n, int64_t off) {
+    size_t item = mesh_item(type);
+    if (!item || n < 0 || off < MESH_HEAD || (off & 7) ||
+        (uint64_t)off + MESH_CHUNK_HEAD > mf->size ||
+        (uint64_t)n > (mf->size - off - MESH_CHUNK_HEAD) / item ||
+        mf->nchunk >= cap) return 0;
+    MeshChunk *c = mf->chunk + mf->nchunk++;
+    c->type = type;
+    c->tag = tag;
+    c->n = n;
+    c->data = (const char *)mf->map + off + MESH_CHUNK_HEAD;
+    if (type == MESH_VERT) mf->nv += n;
+    if (type == MESH_TRI) mf->ntri += n;
+    if (type == MESH_QUAD) mf->nquad += n;
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Map a mesh file and read its table
+  Returns 1, or 0 if the file cannot be read or is not a mesh
+  file of this version and byte order (mf is then empty).
+-------------------------------------------------------------*/
+int mesh_file_open(MeshFile *mf, const char *path) {
+    *mf = (MeshFile)MESH_FILE_INIT;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < MESH_HEAD) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    mf->map = map;
+    mf->size = st.st_size;
+
+    const char *b = map;
+    uint32_t ver, bom;
+    int64_t nc, toc;
+    memcpy(&ver, b + 8, 4);
+    memcpy(&bom, b + 12, 4);
+    memcpy(&nc, b + 16, 8);
+    memcpy(&toc, b + 24, 8);
+    if (memcmp(b, MESH_MAGIC, 8) != 0 || ver != MESH_FILE_VERSION || bom != MESH_BOM)
+        goto fail;
+
+    if (toc > 0) {
+        /* ---- Closed file: the table ---- */
+        if (nc < 0 || toc < MESH_HEAD || (uint64_t)toc > mf->size ||
+            (uint64_t)nc > (mf->size - toc) / 24 || nc > INT32_MAX) goto fail;
+        mf->chunk = malloc((nc > 0 ? nc : 1) * sizeof(MeshChunk));
+        if (!mf->chunk) goto fail;
+        for (int64_t c = 0; c < nc; c++) {
+            const char *p = b + toc + 24 * c;
+            int32_t h[2];
+            int64_t v[2];
+            memcpy(h, p, sizeof(h));
+            memcpy(v, p + 8, sizeof(v));
+            if (!mesh_add_chunk(mf, (int)nc, h[0], h[1], v[0], v[1])) goto fail;
+        }
+    } else {
+        /* ---- Unfinished file: walk the chunk headers ---- */
+        int cap = 0;
+        int64_t off = MESH_HEAD;
+        while ((uint64_t)off + MESH_CHUNK_HEAD <= mf->size) {
+            int32_t h[2];
+            int64_t n;
+            memcpy(h, b + off, sizeof(h));
+            memcpy(&n, b + off + 8, sizeof(n));
+            size_t item = mesh_item(h[0]);
+            if (!item || n <= 0) break;
+            if (mf->nchunk == cap) {
+                cap = cap > 0 ? 2 * cap : 64;
+                MeshChunk *q = realloc(mf->chunk, cap * sizeof(MeshChunk));
+                if (!q) goto fail;
+                mf->chunk = q;
+            }
+            if (!mesh_add_chunk(mf, cap, h[0], h[1], n, off)) break;
+            off += MESH_CHUNK_HEAD + (int64_t)((n * item + 7) & ~(size_t)7);
+        }
+    }
+    return 1;
+
+fail:
+    mesh_file_close(mf);
+    return 0;
+}
+
+/*-------------------------------------------------------------
+  Unmap a mesh file and leave mf empty
+-------------------------------------------------------------*/
+void mesh_file_close(MeshFile *mf) {
+    if (mf->map) munmap(mf->map, mf->size);
+    free(mf->chunk);
+    *mf = (MeshFile)MESH_FILE_INIT;
+}
+
+/*-------------------------------------------------------------
+  Gather the vertices: x, y (mf->nv each) and the layer of each
+  vertex; any of them may be NULL. Returns the number of
+  vertices.
+-------------------------------------------------------------*/
+int64_t mesh_file_vertices(const MeshFile *mf, double *x, double *y, int *layer) {
+    int64_t k = 0;
+    for (int c = 0; c < mf->nchunk; c++) {
+        const MeshChunk *ch = mf->chunk + c;
+        if (ch->type != MESH_VERT) continue;
+        const double *p = ch->data;
+        if (x) memcpy(x + k, p, ch->n * sizeof(double));
+        if (y) memcpy(y + k, p + ch->n, ch->n * sizeof(double));
+        if (layer) for (int64_t i = 0; i < ch->n; i++) layer[k + i] = ch->tag;
+        k += ch->n;
+    }
+    return k;
+}
+
+/*-------------------------------------------------------------
+  Gather the chunks of one element type (MESH_TRI, MESH_QUAD,
+  MESH_NBR3, MESH_NBR4): el receives their entries, band the
+  band of each element; either may be NULL. Returns the number
+  of elements, or -1 for an unknown type.
+-------------------------------------------------------------*/
+int64_t mesh_file_elements(const MeshFile *mf, int type, int *el, int *band) {
+    size_t item = type == MESH_VERT ? 0 : mesh_item(type);
+    if (!item) return -1;
+    int64_t k = 0;
+    for (int c = 0; c < mf->nchunk; c++) {
+        const MeshChunk *ch = mf->chunk + c;
+        if (ch->type != type) continue;
+        if (el) memcpy((char *)el + k * item, ch->data, ch->n * item);
+        if (band) for (int64_t i = 0; i < ch->n; i++) band[k + i] = ch->tag;
+        k += ch->n;
+    }
+    return k;
+}
+
+/*-------------------------------------------------------------
+  Helper: next element of a mapped file, triangles first, then
+  quads. it->k is its number of vertices, *band its band.
+  Returns its vertex indices, or NULL after the last one.
+-------------------------------------------------------------*/
+typedef struct {
+    int k, c;                  // vertices per element, chunk
+    int64_t e;                 // element in the chunk
+} MeshIter;
+
+static const int32_t *mesh_next(const MeshFile *mf, MeshIter *it, int *band) {
+    while (it->k <= 4) {
+        if (it->c < mf->nchunk) {
+            const MeshChunk *ch = mf->chunk + it->c;
+            if (ch->type == (it->k == 3 ? MESH_TRI : MESH_QUAD) && it->e < ch->n) {
+                if (band) *band = ch->tag;
+                return (const int32_t *)ch->data + it->k * it->e++;
+            }
+            it->c++;
+            it->e = 0;
+        } else {
+            it->k++;
+            it->c = 0;
+        }
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------
+  Export a mapped mesh to path as MESH_VTK or MESH_GMSH
+  Returns 1, or 0 if the file cannot be written or an element
+  refers to a vertex that is not in the file.
+-------------------------------------------------------------*/
+int mesh_file_export(const MeshFile *mf, const char *path, int format) {
+    if (format != MESH_VTK && format != MESH_GMSH) return 0;
+    int64_t nv = mf->nv, ne = mf->ntri + mf->nquad;
+    MeshIter it = { 3, 0, 0 };
+    const int32_t *v;
+    int band;
+    while ((v = mesh_next(mf, &it, NULL)))
+        for (int i = 0; i < it.k; i++)
+            if (v[i] < 0 || v[i] >= nv) return 0;
+
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    setvbuf(f, NULL, _IOFBF, MESH_BUFFER);
+
+    if (format == MESH_VTK) {
+        fprintf(f, "# vtk DataFile Version 3.0\ngrid2d mesh\nASCII\nDATASET UNSTRUCTURED_GRID\n");
+        fprintf(f, "POINTS %lld double\n", (long long)nv);
+        for (int c = 0; c < mf->nchunk; c++) {
+            const MeshChunk *ch = mf->chunk + c;
+            if (ch->type != MESH_VERT) continue;
+            const double *p = ch->data;
+            for (int64_t i = 0; i < ch->n; i++) fprintf(f, "%.17g %.17g 0\n", p[i], p[ch->n + i]);
+        }
+        fprintf(f, "CELLS %lld %lld\n", (long long)ne, (long long)(4 * mf->ntri + 5 * mf->nquad));
+        it = (MeshIter){ 3, 0, 0 };
+        while ((v = mesh_next(mf, &it, NULL))) {
+            fprintf(f, "%d", it.k);
+            for (int i = 0; i < it.k; i++) fprintf(f, " %d", v[i]);
+            fputc('\n', f);
+        }
+        fprintf(f, "CELL_TYPES %lld\n", (long long)ne);
+        it = (MeshIter){ 3, 0, 0 };
+        while (mesh_next(mf, &it, NULL)) fprintf(f, "%d\n", it.k == 3 ? 5 : 9);
+        fprintf(f, "CELL_DATA %lld\nSCALARS band int 1\nLOOKUP_TABLE default\n", (long long)ne);
+        it = (MeshIter){ 3, 0, 0 };
+        while (mesh_next(mf, &it, &band)) fprintf(f, "%d\n", band);
+        fprintf(f, "POINT_DATA %lld\nSCALARS layer int 1\nLOOKUP_TABLE default\n", (long long)nv);
+        for (int c = 0; c < mf->nchunk; c++) {
+            const MeshChunk *ch = mf->chunk + c;
+            if (ch->type != MESH_VERT) continue;
+            for (int64_t i = 0; i < ch->n; i++) fprintf(f, "%d\n", ch->tag);
+        }
+    } else {
+        fprintf(f, "$MeshFormat\n2.2 0 8\n$EndMeshFormat\n");
+        fprintf(f, "$Nodes\n%lld\n", (long long)nv);
+        int64_t id = 1;
+        for (int c = 0; c < mf->nchunk; c++) {
+            const MeshChunk *ch = mf->chunk + c;
+            if (ch->type != MESH_VERT) continue;
+            const double *p = ch->data;
+            for (int64_t i = 0; i < ch->n; i++)
+                fprintf(f, "%lld %.17g %.17g 0\n", (long long)id++, p[i], p[ch->n + i]);
+        }
+        fprintf(f, "$EndNodes\n$Elements\n%lld\n", (long long)ne);
+        id = 1;
+        it = (MeshIter){ 3, 0, 0 };
+        while ((v = mesh_next(mf, &it, &band))) {
+            fprintf(f, "%lld %d 2 %d %d", (long long)id++, it.k == 3 ? 2 : 3, band + 1, band + 1);
+            for (int i = 0; i < it.k; i++) fprintf(f, " %d", v[i] + 1);
+            fputc('\n', f);
+        }
+        fprintf(f, "$EndElements\n");
+    }
+    int ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+    return ok;
+}
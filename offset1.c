@@ -1,165 +1,261 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <math.h>
+#ifndef GRID2D_NO_D
 #include "D.h"
+#endif
+#include "grid2d.h"
+#include "offset_engine.h"
 
 /*-------------------------------------------------------------
   Parallel curve generator
   -------------------------------------------------------------
   Given a polyline defined by arrays (x[i], y[i]), this routine
-  builds another polyline offset to the right by a distance h.
+  builds another polyline offset by a distance h, to the left of
+  the curve for h > 0 and to the right for h < 0.
 
   The algorithm proceeds segment by segment:
-  - For each corner, it constructs the outward normal bisector.
+  - For each corner, it constructs the outward normal bisector
+    (computed ahead for a window of vertices, see offset_kernel.h).
   - It generates the offset points A, B, etc.
-  - If two offset segments intersect, the intersection is skipped.
+  - If the offset segment AB folds back over the base segment
+    (the diagonals of the quad P_i, P_{i+1}, B, A do not cross),
+    the point B is skipped and A is kept.
   - Otherwise, the routine may add one or two points depending
     on geometric criteria (length limits lmin, lmax).
 
+  The loop itself is the offset engine (offset_engine.h) with
+  direct input, buffer output and the lmin/lmax filter.
+
   Output points (x0, y0) are stored sequentially up to nmax entries.
-  If overflow occurs, the function returns 0.
+  If overflow occurs, the function returns 0. Each segment stores at
+  most two points, so nmax = 2*n - 1 never overflows.
+-------------------------------------------------------------*/
+
+/*-------------------------------------------------------------
+  Tracing
+  -------------------------------------------------------------
+  When compiled with -DGRID2D_TRACE, build_parallel_curve records
+  one compact event per decision into a per-thread ring buffer
+  holding the last PARALLEL_TRACE_SIZE events. The trace is read
+  back after the call with parallel_trace_read. Without the flag
+  the TRACE macro expands to nothing and the kernel has no
+  tracing cost at all.
 -------------------------------------------------------------*/
+#ifdef GRID2D_TRACE
+
+static _Thread_local ParallelTraceEvent trace_ring[PARALLEL_TRACE_SIZE];
+static _Thread_local long trace_count = 0;
+static _Thread_local int trace_on = 0;    // trace flag of the running call
 
-typedef struct { double x, y; } Point;
+static void trace_put(int kind, int seg, int m) {
+    ParallelTraceEvent *e = &trace_ring[trace_count++ & (PARALLEL_TRACE_SIZE - 1)];
+    e->kind = kind;
+    e->seg = seg;
+    e->m = m;
+}
+
+#define TRACE(kind, seg, m) do { if (trace_on) trace_put(kind, seg, m); } while (0)
+
+#else
+
+#define TRACE(kind, seg, m) ((void)0)
+
+#endif
 
 /*-------------------------------------------------------------
-  Helper: Euclidean distance between two points
+  Copy the recorded events, oldest first, into ev[0..max-1]
+  Returns the number of events copied (0 without GRID2D_TRACE)
 -------------------------------------------------------------*/
-static double distance(Point a, Point b) {
-    double dx = b.x - a.x, dy = b.y - a.y;
-    return sqrt(dx*dx + dy*dy);
+int parallel_trace_read(ParallelTraceEvent *ev, int max) {
+#ifdef GRID2D_TRACE
+    long first = trace_count > PARALLEL_TRACE_SIZE ? trace_count - PARALLEL_TRACE_SIZE : 0;
+    int k = 0;
+    for (long c = first; c < trace_count && k < max; c++)
+        ev[k++] = trace_ring[c & (PARALLEL_TRACE_SIZE - 1)];
+    return k;
+#else
+    (void)ev; (void)max;
+    return 0;
+#endif
 }
 
 /*-------------------------------------------------------------
-  Helper: Check if two line segments (p1,p2) and (q1,q2) intersect
+  Discard the recorded events
 -------------------------------------------------------------*/
-static int intersect(Point p1, Point p2, Point q1, Point q2) {
-    double d = (p2.x - p1.x) * (q2.y - q1.y) - (p2.y - p1.y) * (q2.x - q1.x);
-    if (fabs(d) < 1e-12) return 0;  // Parallel or coincident
+void parallel_trace_clear(void) {
+#ifdef GRID2D_TRACE
+    trace_count = 0;
+#endif
+}
 
-    double t = ((q1.x - p1.x) * (q2.y - q1.y) - (q1.y - p1.y) * (q2.x - q1.x)) / d;
-    double u = ((q1.x - p1.x) * (p2.y - p1.y) - (q1.y - p1.y) * (p2.x - p1.x)) / d;
-    return (t >= 0 && t <= 1 && u >= 0 && u <= 1);
+/*-------------------------------------------------------------
+  Print the recorded events in readable form
+-------------------------------------------------------------*/
+void parallel_trace_print(FILE *f) {
+#ifdef GRID2D_TRACE
+    static const char *name[] = {
+        "start", "fold", "skip", "insert C", "append B", "overflow", "end"
+    };
+    long first = trace_count > PARALLEL_TRACE_SIZE ? trace_count - PARALLEL_TRACE_SIZE : 0;
+    for (long c = first; c < trace_count; c++) {
+        ParallelTraceEvent *e = &trace_ring[c & (PARALLEL_TRACE_SIZE - 1)];
+        fprintf(f, "build_parallel_curve: %-8s seg=%d m=%d\n", name[e->kind], e->seg, e->m);
+    }
+#else
+    (void)f;
+#endif
 }
 
 /*-------------------------------------------------------------
-  Main routine: build a right-hand offset (parallel) curve
+  Offset loop: direct input, buffer output, lmin/lmax filter
+-------------------------------------------------------------*/
+#define OE_NAME parallel_engine
+#define OE_INPUT OE_DIRECT
+#define OE_SINK OE_BUFFER
+#define OE_FILTER 1
+#define OE_TRACE(kind, seg, m) TRACE(kind, seg, m)
+#include "offset_engine.h"
+
+/*-------------------------------------------------------------
+  Same loop on float coordinates (OE_FLOAT)
+-------------------------------------------------------------*/
+#define OE_NAME parallel_engine_f
+#define OE_INPUT OE_DIRECT
+#define OE_SINK OE_BUFFER
+#define OE_FILTER 1
+#define OE_FLOAT 1
+#define OE_TRACE(kind, seg, m) TRACE(kind, seg, m)
+#include "offset_engine.h"
+
+/*-------------------------------------------------------------
+  Main routine: build a left-hand offset (parallel) curve
 -------------------------------------------------------------*/
 int build_parallel_curve(
     double *x, double *y, int n,     // Input polyline
     double h,                        // Offset distance
     double lmin, double lmax,        // Length thresholds
     double *x0, double *y0, int nmax, // Output buffer and limit
-    int verbose                      // Control debug output
+    int trace                        // Record trace events
 ) {
-    if (n < 2) {
-        if (verbose) printf("build_parallel_curve: n < 2, nothing to do\n");
-        return 0;
-    }
+#ifdef GRID2D_TRACE
+    trace_on = trace;
+#else
+    (void)trace;
+#endif
+    return parallel_engine(x, y, n, h, lmin, lmax, x0, y0, nmax);
+}
 
-    int m = 0;
-    Point A, B;
+/*-------------------------------------------------------------
+  Single precision version: float input and output. The offset
+  points are computed in float, with twice the SIMD width of the
+  double kernel; the fold test and the lmin/lmax filter work in
+  double on the float points. Since those points are rounded,
+  the output may depart from that of build_parallel_curve after
+  the first skip or insertion that the rounding changes.
+-------------------------------------------------------------*/
+int build_parallel_curve_f(
+    float *x, float *y, int n,       // Input polyline
+    double h,                        // Offset distance
+    double lmin, double lmax,        // Length thresholds
+    float *x0, float *y0, int nmax,  // Output buffer and limit
+    int trace                        // Record trace events
+) {
+#ifdef GRID2D_TRACE
+    trace_on = trace;
+#else
+    (void)trace;
+#endif
+    return parallel_engine_f(x, y, n, h, lmin, lmax, x0, y0, nmax);
+}
 
-    if (verbose) printf("build_parallel_curve: start n=%d h=%g lmin=%g lmax=%g nmax=%d\n", n, h, lmin, lmax, nmax);
+/*-------------------------------------------------------------
+  Same, writing into the output buffers of a workspace, which
+  grow to 2*n - 1 points only when needed (see workspace.c).
+  *x0, *y0 are set to the buffers.
+-------------------------------------------------------------*/
+int build_parallel_curve_ws(
+    Grid2DWork *w,
+    double *x, double *y, int n,     // Input polyline
+    double h,                        // Offset distance
+    double lmin, double lmax,        // Length thresholds
+    double **x0, double **y0,        // Output: workspace buffers
+    int trace                        // Record trace events
+) {
+    int nmax = n > 1 ? 2 * n - 1 : 1;
+    if (!grid2d_work_reserve_xy(w, nmax)) return 0;
+    *x0 = w->x0;
+    *y0 = w->y0;
+    return build_parallel_curve(x, y, n, h, lmin, lmax, w->x0, w->y0, nmax, trace);
+}
 
-    /* ---- Initial offset point ---- */
-    double dx = x[1] - x[0], dy = y[1] - y[0];
-    double len = sqrt(dx*dx + dy*dy);
-    A.x = x[0] + h * (-dy / len);
-    A.y = y[0] + h * ( dx / len);
+/*-------------------------------------------------------------
+  Multi-layer offset: the same loop run for several distances
+  in one pass (OE_LAYERS)
+-------------------------------------------------------------*/
+#define OE_NAME multi_engine
+#define OE_INPUT OE_DIRECT
+#define OE_SINK OE_BUFFER
+#define OE_FILTER 1
+#define OE_LAYERS 1
+#include "offset_engine.h"
 
-    if (m < nmax) {
-        x0[m] = A.x; y0[m] = A.y; m++;
-        if (verbose) printf("build_parallel_curve: initial A=(%g,%g) stored at m=%d\n", A.x, A.y, m);
-    } else {
-        if (verbose) printf("build_parallel_curve: overflow storing initial point\n");
-        return 0;
+/*-------------------------------------------------------------
+  Offset curves of one polyline at the distances hl[0..nlay-1]
+  -------------------------------------------------------------
+  Gives for every distance the same curve as build_parallel_curve
+  (up to rounding: the points are built as P + h * N from the
+  unit normal N), but reads the base curve and computes its
+  normals once for all the layers instead of once per layer.
+  The layers go through the engine in groups of
+  OFFSET_MAX_LAYERS, each group in a single pass.
+
+  Layer k is stored in a slot of 2n - 1 points starting at
+  k * (2n - 1) in x0, y0, and ml[k] receives its number of
+  points. The slots are not compacted, which would move every
+  point once more; the D wrappers copy the layers to their
+  exact-size arrays in one go. x0, y0 must hold nlay * (2n - 1)
+  points. Returns the total number of points, or 0 if the curve
+  has no offset (n < 2, zero length first segment).
+-------------------------------------------------------------*/
+int build_parallel_multi(
+    double *x, double *y, int n,     // Input polyline
+    int nlay, double *hl,            // Offset distances
+    double lmin, double lmax,        // Length thresholds
+    double *x0, double *y0, int *ml  // Output: one slot per layer
+) {
+    if (n < 2 || nlay < 1) return 0;
+    int nmax = 2 * n - 1, m = 0;
+
+    for (int k0 = 0; k0 < nlay; k0 += OFFSET_MAX_LAYERS) {
+        int kn = nlay - k0 < OFFSET_MAX_LAYERS ? nlay - k0 : OFFSET_MAX_LAYERS;
+        size_t p = (size_t)k0 * nmax;
+        int r = multi_engine(x, y, n, kn, hl + k0, lmin, lmax,
+                             x0 + p, y0 + p, nmax, ml + k0);
+        if (r == 0) return 0;
+        m += r;
     }
+    return m;
+}
 
-    /* ---- Process each segment ---- */
-    for (int i = 0; i < n - 1; i++) {
-        if (verbose) printf("build_parallel_curve: segment %d/%d\n", i, n-1);
-
-        Point P1 = {x[i], y[i]};
-        Point P2 = {x[i+1], y[i+1]};
-
-        /* Compute the outward normal at vertex (i+1) */
-        double nx, ny;
-        if (i < n - 2) {
-            double dx1 = x[i+1] - x[i],     dy1 = y[i+1] - y[i];
-            double dx2 = x[i+2] - x[i+1],   dy2 = y[i+2] - y[i+1];
-            double l1 = sqrt(dx1*dx1 + dy1*dy1);
-            double l2 = sqrt(dx2*dx2 + dy2*dy2);
-            dx1 /= l1; dy1 /= l1;
-            dx2 /= l2; dy2 /= l2;
-            nx = -(dy1 + dy2);
-            ny =  (dx1 + dx2);
-            if (verbose) printf("build_parallel_curve: vertex %d normal from two segments nx=%g ny=%g\n", i+1, nx, ny);
-        } else {
-            nx = -(y[i+1] - y[i]);
-            ny =  (x[i+1] - x[i]);
-            if (verbose) printf("build_parallel_curve: vertex %d normal from one segment nx=%g ny=%g\n", i+1, nx, ny);
-        }
-
-        double nlen = sqrt(nx*nx + ny*ny);
-        B.x = x[i+1] + h * nx / nlen;
-        B.y = y[i+1] + h * ny / nlen;
-        if (verbose) printf("build_parallel_curve: computed B=(%g,%g)\n", B.x, B.y);
-
-        /* Check intersection between (P_i,B) and (P_{i+1},A) */
-        int cross = intersect(P1, B, P2, A);
-        if (verbose) printf("build_parallel_curve: intersect=%d\n", cross);
-
-        if (!cross) {
-            /* Segment lengths for geometric filtering */
-            double l1 = (i < n - 2) ? distance(P1, (Point){x[i+2], y[i+2]}) : 1e9;
-            double l2 = distance(A, B);
-            if (verbose) printf("build_parallel_curve: l1=%g l2=%g\n", l1, l2);
-
-            if (l2 < lmin && l2 < l1) {
-                /* Skip point B — too short to be significant */
-                if (verbose) printf("build_parallel_curve: skip B (l2 < lmin and l2 < l1)\n");
-                continue;
-            }
-
-            if (l2 > lmax) {
-                /* Insert an intermediate point C midway between A and B,
-                   adjusted so it lies at distance h from the base segment. */
-                Point M = {(A.x + B.x) / 2.0, (A.y + B.y) / 2.0};
-                double dxs = P2.x - P1.x, dys = P2.y - P1.y;
-                double slen = sqrt(dxs*dxs + dys*dys);
-                Point C = {M.x + h * (-dys / slen), M.y + h * (dxs / slen)};
-
-                if (m < nmax) {
-                    x0[m] = C.x; y0[m] = C.y; m++;
-                    if (verbose) printf("build_parallel_curve: inserted C=(%g,%g) at m=%d\n", C.x, C.y, m);
-                } else {
-                    if (verbose) printf("build_parallel_curve: overflow inserting C\n");
-                    return 0;
-                }
-            }
-
-            /* Append point B and continue */
-            if (m < nmax) {
-                x0[m] = B.x; y0[m] = B.y; m++;
-                if (verbose) printf("build_parallel_curve: appended B=(%g,%g) at m=%d\n", B.x, B.y, m);
-            } else {
-                if (verbose) printf("build_parallel_curve: overflow appending B\n");
-                return 0;
-            }
-            A = B;
-
-        } else {
-            /* Intersection — update A but do not store B */
-            if (verbose) printf("build_parallel_curve: intersection detected, updating A to B but not storing\n");
-            A = B;
-        }
+/*-------------------------------------------------------------
+  Geometric boundary layer schedule: the first layer at h0, each
+  layer ratio times thicker than the previous one, so that
+  hl[k] = h0 * (1 + ratio + ... + ratio^k) for k < count
+-------------------------------------------------------------*/
+void parallel_multi_schedule(double h0, double ratio, int count, double *hl) {
+    double t = h0, d = 0.0;
+    for (int k = 0; k < count; k++) {
+        d += t;
+        hl[k] = d;
+        t *= ratio;
     }
-
-    if (verbose) printf("build_parallel_curve: finished, produced m=%d points\n", m);
-    return m;
 }
 
+#ifndef GRID2D_NO_D
+
 /*-------------------------------------------------------------
   Simplified wrapper for parallel curve generation
   All parameters are pointers to type D structures
@@ -167,7 +263,7 @@ int build_parallel_curve(
 -------------------------------------------------------------*/
 D *_parallel5(D *x, D *y, D *h, D *lmin, D *lmax) {
     // Check if there were errors in upper levels
-    if (DError) {
+    if (!DRun) {
         // Free all arguments
         DLibera(x);
         DLibera(y);
@@ -203,40 +299,31 @@ D *_parallel5(D *x, D *y, D *h, D *lmin, D *lmax) {
         return DCreaNulo();
     }
 
-    const int nmax = 1000;  // Maximum number of output points
     int n = x->n;          // Get number of points from x structure
-    
-    // Get pointers to the data arrays from the input structures
-    double *xd = x->p.d;
-    double *yd = y->p.d;
-    
-    // Allocate temporary arrays for build_parallel_curve output
-    double *x0d = malloc(nmax * sizeof(double));
-    double *y0d = malloc(nmax * sizeof(double));
-    
+
     // Get the scalar values from the D structures
     double hd = h->p.d[0];
     double lmin_val = lmin->p.d[0];
     double lmax_val = lmax->p.d[0];
-    
-    // Call the original function with the data arrays and parameter values
-    int result = build_parallel_curve(xd, yd, n, hd, lmin_val, lmax_val, x0d, y0d, nmax, 1); // verbose=1
 
-    // Create D structures for the output using the result size
-    D *x0 = NULL;
-    D *y0 = NULL;
+    // Upper bound of the output size: the initial point plus at most
+    // one inserted point C and one point B per segment
+    int nmax = n > 1 ? 2 * n - 1 : 1;
+
+    // Create the output D structures and let build_parallel_curve
+    // write straight into their data arrays; the offset needs no
+    // scratch memory, so the shared workspace is not used
+    D *x0 = DCreaDouble(nmax);
+    D *y0 = DCreaDouble(nmax);
     D *output = NULL;
 
+    int result = build_parallel_curve(x->p.d, y->p.d, n, hd, lmin_val, lmax_val,
+                                      x0->p.d, y0->p.d, nmax, 1); // trace=1
+
     if (result > 0) {
-        // Create D structures with the exact size needed
-        x0 = DCreaDouble(result);
-        y0 = DCreaDouble(result);
-
-        // Copy the data to the D structures
-        for(int i = 0; i < result; i++) {
-            x0->p.d[i] = x0d[i];
-            y0->p.d[i] = y0d[i];
-        }
+        // Trim the logical size to the points actually produced
+        x0->n = result;
+        y0->n = result;
 
         // Create the output list and insert the structures
         output = DCreaLista();
@@ -244,13 +331,11 @@ D *_parallel5(D *x, D *y, D *h, D *lmin, D *lmax) {
         DInserta(output, y0);
     } else {
         // Create a null structure if no result
+        DLibera(x0);
+        DLibera(y0);
         output = DCreaNulo();
     }
 
-    // Free temporary arrays
-    free(x0d);
-    free(y0d);
-    
     // Free all input arguments
     DLibera(x);
     DLibera(y);
@@ -260,3 +345,245 @@ D *_parallel5(D *x, D *y, D *h, D *lmin, D *lmax) {
     
     return output;
 }
+
+/*-------------------------------------------------------------
+  Wrapper to read back the trace of the last parallel curves
+  Returns: D integer array with 3 values (kind, seg, m) per event,
+  oldest first, or DCreaNulo() if there are no events (always the
+  case unless compiled with -DGRID2D_TRACE). The trace is cleared.
+-------------------------------------------------------------*/
+D *_parallel_trace0(void) {
+    if (!DRun) return DCreaNulo();
+
+    ParallelTraceEvent *ev = malloc(PARALLEL_TRACE_SIZE * sizeof(ParallelTraceEvent));
+    int k = parallel_trace_read(ev, PARALLEL_TRACE_SIZE);
+    parallel_trace_clear();
+
+    D *output;
+    if (k > 0) {
+        output = DCreaInt(3 * k);
+        for (int i = 0; i < k; i++) {
+            output->p.i[3*i+0] = ev[i].kind;
+            output->p.i[3*i+1] = ev[i].seg;
+            output->p.i[3*i+2] = ev[i].m;
+        }
+    } else {
+        output = DCreaNulo();
+    }
+    free(ev);
+    return output;
+}
+
+/*-------------------------------------------------------------
+  Helper of the multi-layer wrappers: total number of points in
+  the layer slots, nlay * (2n - 1), or -1 if it exceeds INT_MAX
+-------------------------------------------------------------*/
+static int multi_slots(int n, int nlay) {
+    if (n < 1 || nlay < 1) return 0;
+    size_t slot = 2 * (size_t)n - 1;
+    if ((size_t)nlay > INT_MAX / slot) return -1;
+    return (int)(slot * (size_t)nlay);
+}
+
+/*-------------------------------------------------------------
+  Helper of the multi-layer wrappers: offsets into the shared
+  workspace and copies the layers to a D list x0, y0, off0
+  Returns NULL if the workspace cannot be allocated; the caller
+  has checked multi_slots.
+-------------------------------------------------------------*/
+static D *multi_output(D *x, D *y, int nlay, double *hl, double lmin, double lmax) {
+    int n = x->n;
+    if (n < 2) return DCreaNulo();
+    size_t slot = 2 * (size_t)n - 1;
+    Grid2DWork *w = grid2d_d_work();
+    grid2d_work_reset(w);
+    int *ml = grid2d_work_alloc(w, (size_t)nlay * sizeof(int));
+    if (!ml || !grid2d_work_reserve_xy(w, multi_slots(n, nlay))) return NULL;
+    int m = build_parallel_multi(x->p.d, y->p.d, n, nlay, hl, lmin, lmax,
+                                 w->x0, w->y0, ml);
+    if (m <= 0) return DCreaNulo();
+
+    // Gather the layer slots into the CSR arrays
+    D *dx = DCreaDouble(m);
+    D *dy = DCreaDouble(m);
+    D *doff = DCreaInt(nlay + 1);
+    doff->p.i[0] = 0;
+    for (int k = 0; k < nlay; k++) {
+        size_t p = (size_t)k * slot;
+        int o = doff->p.i[k];
+        memcpy(dx->p.d + o, w->x0 + p, ml[k] * sizeof(double));
+        memcpy(dy->p.d + o, w->y0 + p, ml[k] * sizeof(double));
+        doff->p.i[k+1] = o + ml[k];
+    }
+
+    D *output = DCreaLista();
+    DInserta(output, dx);
+    DInserta(output, dy);
+    DInserta(output, doff);
+    return output;
+}
+
+/*-------------------------------------------------------------
+  Wrapper for the multi-layer offset
+  Inputs (D*):
+    x, y       : double arrays with the base polyline
+    h          : double array with the offset distance of each
+                 layer
+    lmin, lmax : double scalars, length thresholds
+  Returns: D list with the offset curves x0, y0, one layer after
+  another, and their CSR offsets off0, or DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_parallel_multi5(D *x, D *y, D *h, D *lmin, D *lmax) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        h->t != D_TIPO_DOUBLE || lmin->t != D_TIPO_DOUBLE ||
+        lmax->t != D_TIPO_DOUBLE) {
+        DError("parallel_multi : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || h->n < 1 || lmin->n != 1 || lmax->n != 1) {
+        DError("parallel_multi : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check the size of the output
+    if (multi_slots(x->n, h->n) < 0) {
+        DError("parallel_multi : output too large");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    D *output = multi_output(x, y, h->n, h->p.d, lmin->p.d[0], lmax->p.d[0]);
+    if (!output) {
+        DError("parallel_multi : out of memory");
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(h);
+    DLibera(lmin);
+    DLibera(lmax);
+
+    return output;
+}
+
+/*-------------------------------------------------------------
+  Wrapper for the multi-layer offset with a geometric schedule
+  Inputs (D*):
+    x, y       : double arrays with the base polyline
+    h0         : double scalar, thickness of the first layer
+    ratio      : double scalar, growth ratio of the thickness
+    count      : integer, number of layers
+    lmin, lmax : double scalars, length thresholds
+  Returns: the same list as _parallel_multi5
+-------------------------------------------------------------*/
+D *_parallel_geometric7(D *x, D *y, D *h0, D *ratio, D *count, D *lmin, D *lmax) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(h0);
+        DLibera(ratio);
+        DLibera(count);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        h0->t != D_TIPO_DOUBLE || ratio->t != D_TIPO_DOUBLE ||
+        count->t != D_TIPO_INT || lmin->t != D_TIPO_DOUBLE ||
+        lmax->t != D_TIPO_DOUBLE) {
+        DError("parallel_geometric : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h0);
+        DLibera(ratio);
+        DLibera(count);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || h0->n != 1 || ratio->n != 1 || count->n != 1 ||
+        count->p.i[0] < 1 || lmin->n != 1 || lmax->n != 1) {
+        DError("parallel_geometric : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h0);
+        DLibera(ratio);
+        DLibera(count);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check the size of the output
+    int nlay = count->p.i[0];
+    if (multi_slots(x->n, nlay) < 0) {
+        DError("parallel_geometric : output too large");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h0);
+        DLibera(ratio);
+        DLibera(count);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    double *hl = malloc((size_t)nlay * sizeof(double));
+    D *output = NULL;
+    if (hl) {
+        parallel_multi_schedule(h0->p.d[0], ratio->p.d[0], nlay, hl);
+        output = multi_output(x, y, nlay, hl, lmin->p.d[0], lmax->p.d[0]);
+        free(hl);
+    }
+    if (!output) {
+        DError("parallel_geometric : out of memory");
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(h0);
+    DLibera(ratio);
+    DLibera(count);
+    DLibera(lmin);
+    DLibera(lmax);
+
+    return output;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Helper: slot of a curve of n points in the batch output
+-------------------------------------------------------------*/
+static inline int parallel_batch_slot(int n) {
+    return n > 0 ? 2 * n - 1 : 0;
+}
+
+/*-------------------------------------------------------------
+  Batch parallel curve generator
+  -------------------------------------------------------------
+  Offsets many independent curves in one call. The curves are
+  given in CSR form: curve c is made of the points
+  off[c] .. off[c+1]-1 of the arrays x, y.
+
+  Every curve c can produce at most 2*n_c - 1 points, so it gets
+  a private slot of that size in the output arrays (none for an
+  empty curve), the slots following each other in curve order.
+  Their starts are a prefix sum, kept in off0 while the curves
+  are offset. The curves are offset concurrently with OpenMP
+  dynamic scheduling: idle threads keep taking the next curve,
+  so a few long curves do not stall the others. The slots are
+  then compacted in curve order, and off0 receives the CSR
+  offsets of the result.
+
+  x0, y0 must hold parallel_batch_size(off, ncurves) points;
+  off0 must hold ncurves+1 entries. A curve with less than 2
+  points, or whose offset fails, produces no points.
+  Returns the total number of points.
+  Compile with -fopenmp; otherwise the curves run one by one.
+-------------------------------------------------------------*/
+int build_parallel_batch(
+    double *x, double *y, int *off, int ncurves,  // Input curves (CSR)
+    double h,                                     // Offset distance
+    double lmin, double lmax,                     // Length thresholds
+    double *x0, double *y0, int *off0             // Output curves (CSR)
+) {
+    /* ---- Slot starts; off0[c] is replaced by the count of curve c ---- */
+    off0[0] = 0;
+    for (int c = 0; c < ncurves; c++)
+        off0[c+1] = off0[c] + parallel_batch_slot(off[c+1] - off[c]);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < ncurves; c++) {
+        int n = off[c+1] - off[c];
+        int p = off0[c];
+        off0[c] = n < 2 ? 0 :
+            build_parallel_curve(x + off[c], y + off[c], n, h, lmin, lmax,
+                                 x0 + p, y0 + p, 2 * n - 1, 0);
+    }
+
+    /* ---- Compact the slots in curve order ---- */
+    int p = 0, q = 0;
+    for (int c = 0; c < ncurves; c++) {
+        int m = off0[c];
+        if (p != q && m > 0) {
+            memmove(x0 + q, x0 + p, m * sizeof(double));
+            memmove(y0 + q, y0 + p, m * sizeof(double));
+        }
+        off0[c] = q;
+        p += parallel_batch_slot(off[c+1] - off[c]);
+        q += m;
+    }
+    off0[ncurves] = q;
+    return q;
+}
+
+/*-------------------------------------------------------------
+  Points needed in x0, y0 by build_parallel_batch: the sum of
+  the slots 2*n_c - 1 of the non-empty curves. The offsets off
+  must be non-decreasing.
+  Returns the size, or -1 if it does not fit in an int.
+-------------------------------------------------------------*/
+int parallel_batch_size(const int *off, int ncurves) {
+    long long size = 0;
+    for (int c = 0; c < ncurves; c++)
+        size += parallel_batch_slot(off[c+1] - off[c]);
+    return size <= INT_MAX ? (int)size : -1;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the batch parallel curve generator
+  Inputs (D*):
+    x, y       : double arrays with all the curves, one after another
+    off        : integer array with ncurves+1 CSR offsets into x, y
+    h          : double scalar, offset distance
+    lmin, lmax : double scalars, length thresholds
+  Returns: D list with the offset curves x0, y0 and their CSR
+  offsets off0, or DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_parallel_batch6(D *x, D *y, D *off, D *h, D *lmin, D *lmax) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(off);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        off->t != D_TIPO_INT || h->t != D_TIPO_DOUBLE ||
+        lmin->t != D_TIPO_DOUBLE || lmax->t != D_TIPO_DOUBLE) {
+        DError("parallel_batch : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(off);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments and that the offsets are increasing
+    int nc = off->n - 1;
+    int ok = x->n == y->n && nc >= 1 && h->n == 1 && lmin->n == 1 && lmax->n == 1 &&
+             off->p.i[0] == 0 && off->p.i[nc] == x->n;
+    for (int c = 0; ok && c < nc; c++)
+        if (off->p.i[c+1] < off->p.i[c]) ok = 0;
+    if (!ok) {
+        DError("parallel_batch : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(off);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Output arrays with room for every curve slot
+    int nmax = parallel_batch_size(off->p.i, nc);
+    if (nmax < 0) {
+        DError("parallel_batch : output too large");
+        DLibera(x);
+        DLibera(y);
+        DLibera(off);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+    D *x0 = DCreaDouble(nmax > 0 ? nmax : 1);
+    D *y0 = DCreaDouble(nmax > 0 ? nmax : 1);
+    D *off0 = DCreaInt(nc + 1);
+
+    int result = build_parallel_batch(x->p.d, y->p.d, off->p.i, nc,
+                                      h->p.d[0], lmin->p.d[0], lmax->p.d[0],
+                                      x0->p.d, y0->p.d, off0->p.i);
+
+    D *output;
+    if (result > 0) {
+        // Trim the logical size to the points actually produced
+        x0->n = result;
+        y0->n = result;
+
+        output = DCreaLista();
+        DInserta(output, x0);
+        DInserta(output, y0);
+        DInserta(output, off0);
+    } else {
+        DLibera(x0);
+        DLibera(y0);
+        DLibera(off0);
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(off);
+    DLibera(h);
+    DLibera(lmin);
+    DLibera(lmax);
+
+    return output;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Global self-intersection removal for offset curves
+  -------------------------------------------------------------
+  build_parallel_curve only compares each offset segment with its
+  neighbour. When h is larger than the local radius of curvature
+  the offset polyline forms swallowtail loops spanning many
+  segments. This routine trims them:
+
+  - The segments are bucketed in a uniform grid whose cell size
+    follows the mean segment length, so that every segment only
+    meets the few segments stored in the cells it overlaps.
+  - The polyline is walked from its first point. If the current
+    segment i crosses a later, non adjacent segment j, the loop
+    between them is cut: the crossing point is stored and the
+    walk continues on segment j. When several later segments
+    cross, the farthest one is taken, which removes nested loops
+    at once.
+  - A contact at the start of the current segment is not a
+    crossing (the segment before it saw it at its end), nor one
+    at the end of segment j (segment j+1 sees it at its start):
+    a crossing through a vertex counts once, and two segments
+    that meet at a shared vertex are never cut.
+  - A closed curve (last point equal to the first) has its first
+    and last segments adjacent, and they are skipped as a pair.
+    Any other curve is open, even when its ends cross: its first
+    and last points are always kept. The offset of a closed curve
+    is not closed exactly (toward the inside its first and last
+    segments cross near the start), so the caller closes it with
+    close_offset_curve before cleaning it.
+    A crossing whose loop would hold more than half of the points
+    of a closed curve is the body of the ring seen across its
+    first point, not a swallowtail, and is left alone; a loop
+    straddling the first point is therefore not trimmed.
+
+  close_offset_curve closes the offset of a closed curve in
+  place: if its first and last segments cross, both end points
+  move to the crossing; otherwise the last point is set to the
+  first.
+
+  The expected cost is linear in the number of points for curves
+  of bounded local density.
+  The curve is compacted in place; returns the new number of points.
+  remove_self_intersections_ws takes the grid buckets from the
+  arena of a workspace (see workspace.c) instead of malloc.
+-------------------------------------------------------------*/
+
+/*-------------------------------------------------------------
+  Helper: intersection of segments (p1,p2) and (q1,q2)
+  Returns 1 and the parameter t along (p1,p2) if they cross
+  with t in (0, 1] and u in [0, 1) along (q1,q2)
+-------------------------------------------------------------*/
+static int segment_cross(
+    double p1x, double p1y, double p2x, double p2y,
+    double q1x, double q1y, double q2x, double q2y,
+    double *t)
+{
+    double d = (p2x - p1x) * (q2y - q1y) - (p2y - p1y) * (q2x - q1x);
+    if (fabs(d) < 1e-300) return 0;  // Parallel or coincident
+
+    double tn = (q1x - p1x) * (q2y - q1y) - (q1y - p1y) * (q2x - q1x);
+    double un = (q1x - p1x) * (p2y - p1y) - (q1y - p1y) * (p2x - p1x);
+    if (d < 0) { d = -d; tn = -tn; un = -un; }
+    if (tn <= 0 || tn > d || un < 0 || un >= d) return 0;
+    *t = tn / d;
+    return 1;
+}
+
+void close_offset_curve(double *x, double *y, int n) {
+    if (n < 2) return;
+    double t;
+    if (n >= 4 && segment_cross(x[0], y[0], x[1], y[1], x[n-2], y[n-2], x[n-1], y[n-1], &t)) {
+        x[0] += t * (x[1] - x[0]);
+        y[0] += t * (y[1] - y[0]);
+    }
+    x[n-1] = x[0];
+    y[n-1] = y[0];
+}
+
+int remove_self_intersections_ws(Grid2DWork *ws, double *x, double *y, int n) {
+    if (n < 4) return n;
+    grid2d_work_reset(ws);
+
+    /* ---- Closed curve: last point equal to the first ---- */
+    int closed = x[0] == x[n-1] && y[0] == y[n-1];
+
+    /* ---- Bounding box and mean segment length ---- */
+    double xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0], len = 0;
+    for (int i = 1; i < n; i++) {
+        if (x[i] < xmin) xmin = x[i];
+        if (x[i] > xmax) xmax = x[i];
+        if (y[i] < ymin) ymin = y[i];
+        if (y[i] > ymax) ymax = y[i];
+        len += hypot(x[i] - x[i-1], y[i] - y[i-1]);
+    }
+
+    /* ---- Grid with cells about two segments wide, at most 4n cells ---- */
+    double c = 2.0 * len / (n - 1);
+    double w = xmax - xmin, h = ymax - ymin;
+    if (c <= 0) return n;
+    if ((w / c + 1) * (h / c + 1) > 4.0 * n)
+        c = sqrt((w + c) * (h + c) / (4.0 * n));
+    int gx = (int)(w / c) + 1, gy = (int)(h / c) + 1;
+    double ic = 1.0 / c;
+
+    int *start = grid2d_work_alloc(ws, ((size_t)gx * gy + 1) * sizeof(int));
+    if (!start) return n;
+    memset(start, 0, ((size_t)gx * gy + 1) * sizeof(int));
+
+    /* ---- Pass 1: count the cells overlapped by each segment ---- */
+    #define CELL_RANGE(i)                                                  \
+        int cx0 = (int)((fmin(x[i], x[i+1]) - xmin) * ic);                 \
+        int cx1 = (int)((fmax(x[i], x[i+1]) - xmin) * ic);                 \
+        int cy0 = (int)((fmin(y[i], y[i+1]) - ymin) * ic);                 \
+        int cy1 = (int)((fmax(y[i], y[i+1]) - ymin) * ic);                 \
+        if (cx1 >= gx) cx1 = gx - 1;                                       \
+        if (cy1 >= gy) cy1 = gy - 1;
+
+    for (int i = 0; i < n - 1; i++) {
+        CELL_RANGE(i)
+        for (int b = cy0; b <= cy1; b++)
+            for (int a = cx0; a <= cx1; a++)
+                start[b * gx + a + 1]++;
+    }
+    for (int k = 0; k < gx * gy; k++) start[k+1] += start[k];
+
+    /* ---- Pass 2: store the segment indices cell by cell ---- */
+    int *seg = grid2d_work_alloc(ws, (size_t)start[gx * gy] * sizeof(int));
+    int *fill = grid2d_work_alloc(ws, (size_t)gx * gy * sizeof(int));
+    if (!seg || !fill) return n;
+    for (int k = 0; k < gx * gy; k++) fill[k] = start[k];
+    for (int i = 0; i < n - 1; i++) {
+        CELL_RANGE(i)
+        for (int b = cy0; b <= cy1; b++)
+            for (int a = cx0; a <= cx1; a++)
+                seg[fill[b * gx + a]++] = i;
+    }
+    #undef CELL_RANGE
+
+    /* ---- Walk the polyline, cutting the loops ---- */
+    int m = 1;                        // points kept, x[0] stays
+    double sx = x[0], sy = y[0];      // start of the current segment
+    int i = 0;
+    while (i < n - 1) {
+        double ex = x[i+1], ey = y[i+1];
+        int cx0 = (int)((fmin(sx, ex) - xmin) * ic);
+        int cx1 = (int)((fmax(sx, ex) - xmin) * ic);
+        int cy0 = (int)((fmin(sy, ey) - ymin) * ic);
+        int cy1 = (int)((fmax(sy, ey) - ymin) * ic);
+        if (cx1 >= gx) cx1 = gx - 1;
+        if (cy1 >= gy) cy1 = gy - 1;
+
+        int best = -1;
+        double tbest = 0;
+        for (int b = cy0; b <= cy1; b++)
+            for (int a = cx0; a <= cx1; a++)
+                for (int k = start[b * gx + a]; k < start[b * gx + a + 1]; k++) {
+                    int j = seg[k];
+                    double t;
+                    if (j <= i + 1 || j <= best) continue;
+                    if (closed && ((i == 0 && j == n - 2) || 2 * (j - i) > n - 1)) continue;
+                    if (segment_cross(sx, sy, ex, ey, x[j], y[j], x[j+1], y[j+1], &t)) {
+                        best = j;
+                        tbest = t;
+                    }
+                }
+
+        if (best < 0) {
+            /* No crossing: keep the end point (m <= i+1, so the
+               points still to be read are never overwritten) */
+            x[m] = ex; y[m] = ey; m++;
+            sx = ex; sy = ey;
+            i++;
+        } else {
+            /* Cut the loop at the crossing point and go on along
+               segment best */
+            sx += tbest * (ex - sx);
+            sy += tbest * (ey - sy);
+            x[m] = sx; y[m] = sy; m++;
+            i = best;
+        }
+    }
+
+    return m;
+}
+
+int remove_self_intersections(double *x, double *y, int n) {
+    Grid2DWork w = GRID2D_WORK_INIT;
+    int m = remove_self_intersections_ws(&w, x, y, n);
+    grid2d_work_free(&w);
+    return m;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the self-intersection removal
+  Inputs (D*):
+    x, y : double arrays with an offset polyline
+  Returns: D list with the trimmed polyline x, y
+  The input arrays are trimmed in place and returned.
+-------------------------------------------------------------*/
+D *_offset_clean2(D *x, D *y) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE) {
+        DError("offset_clean : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n) {
+        DError("offset_clean : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    int m = remove_self_intersections_ws(grid2d_d_work(), x->p.d, y->p.d, x->n);
+    x->n = m;
+    y->n = m;
+
+    D *output = DCreaLista();
+    DInserta(output, x);
+    DInserta(output, y);
+    return output;
+}
+
+#endif
@@ -0,0 +1,456 @@
+/*-------------------------------------------------------------
+  Offset engine
+  -------------------------------------------------------------
+  One implementation of the right/left offset loop shared by
+  build_parallel_curve (offset1.c) and the two offset_curve
+  routines (offset_test.c, test_triangula1.c). It is a template:
+  the includer sets the policies with macros and includes this
+  file, which defines one static function. Included without
+  OE_NAME it only declares the common definitions. Every policy is a
+  preprocessor choice, so each instance is a tight loop with no
+  run-time branching on its configuration.
+
+  Policies (macros to define before including):
+
+    OE_NAME     name of the generated function (required)
+    OE_INPUT    OE_DIRECT   point k is x[k]
+                OE_INDEX0   point k is x[ind[k]]
+                OE_INDEX1   point k is x[ind[k]-1]
+    OE_SINK     OE_BUFFER   points stored in x0[], y0[] up to nmax,
+                            the routine returns 0 on overflow
+                OE_CALLBACK points reported through an
+                            OffsetCallbacks table and a ctx pointer
+    OE_FILTER   0           every valid point B is kept
+                1           lmin/lmax filtering: B is skipped when
+                            AB is shorter than lmin (and than the
+                            chord P_i P_{i+2}), and a point C is
+                            inserted when AB is longer than lmax
+    OE_RESUME   0           the whole curve, from its first point
+                1           segments i0 .. i1-1 only, starting from
+                            the point A given in a[0], a[1] (for
+                            i0 > 0; from i0 = 0 the first point is
+                            emitted as usual); the last A is
+                            written back to a[], and mo[i - i0]
+                            receives the number of points emitted
+                            before segment i, for i = i0 .. i1
+                            (see band_update.c)
+    OE_LAYERS   0           one offset at distance h
+                1           nlay offsets at the distances hl[k],
+                            in one pass over the curve: the unit
+                            normals of each window are computed
+                            once and every layer runs its own
+                            A, fold and filter logic on them.
+                            Layer k is stored at x0 + k*nmax and
+                            ml[k] receives its number of points
+                            (OE_BUFFER only, not with OE_RESUME)
+    OE_FLOAT    0           double coordinates
+                1           float coordinates in and out (the real
+                            type below); the offset points of each
+                            window are computed in float, twice as
+                            many per SIMD register, while the fold
+                            test, the filter and the points C work
+                            in double on the promoted values.
+                            The points B are rounded to float, so
+                            the decisions can differ from those of
+                            the double kernel on the same input,
+                            and the output drift from it past the
+                            first differing skip or insertion; it
+                            is not a bitwise match of the double
+                            path, unlike FE_FLOAT in the zipper
+                            (not with OE_LAYERS)
+    OE_TRACE(kind, seg, m)  optional trace hook (see offset1.c)
+
+  Generated signature, with the optional parts depending on the
+  policies:
+
+    int OE_NAME(const real *x, const real *y,
+                [const int *ind,] int n,
+                double h | int nlay, const double *hl,    (OE_LAYERS)
+                [double lmin, double lmax,]
+                [int i0, int i1, double *a, int *mo,]     (OE_RESUME)
+                real *x0, real *y0, int nmax              (OE_BUFFER)
+                [int *ml]                                 (OE_LAYERS)
+                const OffsetCallbacks *cb, void *ctx)     (OE_CALLBACK)
+
+  where real is double, or float with OE_FLOAT. It returns the
+  number of points emitted (over all the layers).
+
+  Conventions, common to all the instances:
+  - The offset is to the left of the curve for h > 0 (normal
+    (-dy, dx)); a right-hand offset uses -h.
+  - A is always the last point emitted. A point B is valid when
+    the diagonals (P_i, B) and (P_{i+1}, A) of the quad
+    P_i, P_{i+1}, B, A cross; otherwise the offset segment is
+    folded back and B is dropped (the callback sink reports the
+    collapsed triangle P_i, P_{i+1}, A).
+  - Zero length segments are skipped; a curve whose first segment
+    has zero length gives no points.
+  - An inserted point C lies between A and B, at distance h from
+    the line of the base segment.
+  - With OE_CALLBACK, the first point is reported by punto, every
+    valid B by cuadrilatero (A becomes B if it returns non-zero),
+    every folded or skipped segment by triangulo, and an inserted
+    C by punto just before the cuadrilatero of its B.
+-------------------------------------------------------------*/
+
+#ifndef OFFSET_ENGINE_H
+#define OFFSET_ENGINE_H
+
+#include "offset_kernel.h"
+
+#define OE_DIRECT   0
+#define OE_INDEX0   1
+#define OE_INDEX1   2
+
+#define OE_BUFFER   0
+#define OE_CALLBACK 1
+
+#define OFFSET_MAX_LAYERS 64    // layers of one OE_LAYERS call
+
+/*-------------------------------------------------------------
+  Output routines of the callback sink
+-------------------------------------------------------------*/
+typedef struct {
+    void (*punto)(void *ctx, double ax, double ay);
+    int  (*cuadrilatero)(void *ctx, int i0, int i1,
+                         double ax, double ay, double bx, double by);
+    void (*triangulo)(void *ctx, int i0, int i1, double ax, double ay);
+} OffsetCallbacks;
+
+/*-------------------------------------------------------------
+  Helper: do the segments (p1,b) and (p2,a) cross?
+  Compares the numerators of the two parameters with the
+  denominator instead of dividing.
+-------------------------------------------------------------*/
+static inline int oe_diagonals_cross(
+    double p1x, double p1y, double bx, double by,
+    double p2x, double p2y, double ax, double ay)
+{
+    double d = (bx - p1x) * (ay - p2y) - (by - p1y) * (ax - p2x);
+    if (fabs(d) < 1e-12) return 0;  // Parallel or coincident
+    double tn = (p2x - p1x) * (ay - p2y) - (p2y - p1y) * (ax - p2x);
+    double un = (p2x - p1x) * (by - p1y) - (p2y - p1y) * (bx - p1x);
+    if (d < 0) { d = -d; tn = -tn; un = -un; }
+    return tn >= 0 && tn <= d && un >= 0 && un <= d;
+}
+
+#endif
+
+/* ================= template instance ================= */
+
+#ifdef OE_NAME
+
+#ifndef OE_INPUT
+#define OE_INPUT OE_DIRECT
+#endif
+#ifndef OE_SINK
+#define OE_SINK OE_BUFFER
+#endif
+#ifndef OE_FILTER
+#define OE_FILTER 0
+#endif
+#ifndef OE_RESUME
+#define OE_RESUME 0
+#endif
+#ifndef OE_TRACE
+#define OE_TRACE(kind, seg, m) ((void)0)
+#endif
+
+#if OE_INPUT == OE_DIRECT
+#define OE_IX(k) (k)
+#define OE_IND_PARAM
+#elif OE_INPUT == OE_INDEX0
+#define OE_IX(k) (ind[k])
+#define OE_IND_PARAM const int *ind,
+#else
+#define OE_IX(k) (ind[k] - 1)
+#define OE_IND_PARAM const int *ind,
+#endif
+
+#if OE_FILTER
+#define OE_FILTER_PARAMS double lmin, double lmax,
+#else
+#define OE_FILTER_PARAMS
+#endif
+
+#if OE_RESUME
+#define OE_RESUME_PARAMS int i0, int i1, double *a, int *mo,
+#define OE_FIRST i0
+#define OE_LAST  i1
+#else
+#define OE_RESUME_PARAMS
+#define OE_FIRST 0
+#define OE_LAST  (n - 1)
+#endif
+
+#ifndef OE_LAYERS
+#define OE_LAYERS 0
+#endif
+#if OE_LAYERS
+#if OE_RESUME || OE_SINK != OE_BUFFER
+#error "OE_LAYERS needs OE_BUFFER and no OE_RESUME"
+#endif
+#define OE_H_PARAMS int nlay, const double *hl,
+#define OE_LAYER_PARAMS , int *ml
+#else
+#define OE_H_PARAMS double h,
+#define OE_LAYER_PARAMS
+#endif
+
+#ifndef OE_FLOAT
+#define OE_FLOAT 0
+#endif
+#if OE_FLOAT
+#if OE_LAYERS
+#error "OE_FLOAT does not support OE_LAYERS"
+#endif
+#define OE_REAL float
+#define OE_POINTS_WINDOW offset_points_window_f
+/* A point computed in double, as stored */
+#define OE_ROUND(v) ((double)(float)(v))
+#else
+#define OE_REAL double
+#define OE_POINTS_WINDOW offset_points_window
+#define OE_ROUND(v) (v)
+#endif
+
+#if OE_SINK == OE_BUFFER
+#define OE_SINK_PARAMS OE_REAL *x0, OE_REAL *y0, int nmax
+#define OE_NMAX nmax
+/* Store a point, or return 0 on overflow */
+#define OE_STORE(seg, px, py)                                   \
+    do {                                                        \
+        if (m >= nmax) { OE_TRACE(PT_OVERFLOW, seg, m); return 0; } \
+        x0[m] = (px); y0[m] = (py); m++;                        \
+    } while (0)
+#else
+#define OE_SINK_PARAMS const OffsetCallbacks *cb, void *ctx
+#define OE_NMAX 0
+#endif
+
+#if OE_SINK == OE_CALLBACK
+static inline __attribute__((always_inline))
+#else
+static
+#endif
+int OE_NAME(
+    const OE_REAL *x, const OE_REAL *y, OE_IND_PARAM int n,
+    OE_H_PARAMS
+    OE_FILTER_PARAMS
+    OE_RESUME_PARAMS
+    OE_SINK_PARAMS OE_LAYER_PARAMS)
+{
+    int m = 0;
+    double ax, ay;
+    OE_REAL bx[OFFSET_BLOCK], by[OFFSET_BLOCK];
+#if OE_INPUT != OE_DIRECT
+    OE_REAL gx[OFFSET_BLOCK + 2], gy[OFFSET_BLOCK + 2];
+#endif
+
+    if (n < 2) return 0;
+    OE_TRACE(PT_START, n, OE_NMAX);
+
+#if OE_LAYERS
+    /* ---- Initial point of every layer ---- */
+    double lax[OFFSET_MAX_LAYERS], lay[OFFSET_MAX_LAYERS];
+    OE_REAL *const x0l = x0, *const y0l = y0;
+    if (nlay < 1 || nlay > OFFSET_MAX_LAYERS) return 0;
+    {
+        int p = OE_IX(0), q = OE_IX(1);
+        double ux, uy;
+        if (x[q] == x[p] && y[q] == y[p]) return 0;
+        offset_end_point(x[p], y[p], x[q], y[q], 0.0, 0.0, 1.0, &ux, &uy);
+        for (int k = 0; k < nlay; k++) {
+            lax[k] = x[p] + hl[k] * ux;
+            lay[k] = y[p] + hl[k] * uy;
+            x0l[(size_t)k * nmax] = lax[k];
+            y0l[(size_t)k * nmax] = lay[k];
+            ml[k] = 1;
+        }
+    }
+    (void)ax; (void)ay;
+#else
+#if OE_RESUME
+    /* ---- Resume from the given point A ---- */
+    if (i0 > 0) {
+        ax = a[0];
+        ay = a[1];
+    } else
+#endif
+    /* ---- Initial offset point ---- */
+    {
+        int p = OE_IX(0), q = OE_IX(1);
+        if (x[q] == x[p] && y[q] == y[p]) return 0;
+        offset_end_point(x[p], y[p], x[q], y[q], x[p], y[p], h, &ax, &ay);
+        ax = OE_ROUND(ax);
+        ay = OE_ROUND(ay);
+#if OE_SINK == OE_BUFFER
+        OE_STORE(-1, ax, ay);
+#else
+        cb->punto(ctx, ax, ay);
+        m++;
+#endif
+    }
+#endif
+
+#if OE_FILTER
+    /* Squared thresholds, so that the filter needs no sqrt */
+    double lmin2 = lmin > 0.0 ? lmin * lmin : -1.0;
+    double lmax2 = lmax > 0.0 ? lmax * lmax : -1.0;
+#endif
+
+    /* ---- Process the segments window by window ----
+       The windows are always those of a whole-curve run, so that a
+       resumed run computes every point B exactly as it would */
+    for (int s0 = OE_FIRST - OE_FIRST % OFFSET_BLOCK; s0 < OE_LAST; s0 += OFFSET_BLOCK) {
+        int s1 = s0 + OFFSET_BLOCK < n - 1 ? s0 + OFFSET_BLOCK : n - 1;
+        int e0 = s0 > OE_FIRST ? s0 : OE_FIRST;
+        int e1 = s1 < OE_LAST ? s1 : OE_LAST;
+
+        /* Offset points B of the vertices s0+1 .. s1 in one sweep
+           (their unit normals with OE_LAYERS) */
+#if OE_LAYERS
+#define OE_WINDOW offset_normals_window
+#define OE_WH 1.0
+#else
+#define OE_WINDOW OE_POINTS_WINDOW
+#define OE_WH h
+#endif
+#if OE_INPUT == OE_DIRECT
+        OE_WINDOW(x, y, n, s0, s1, OE_WH, bx, by);
+#else
+        int nl = (s1 + 2 < n ? s1 + 2 : n) - s0;
+        for (int k = 0; k < nl; k++) {
+            gx[k] = x[OE_IX(s0 + k)];
+            gy[k] = y[OE_IX(s0 + k)];
+        }
+        OE_WINDOW(gx, gy, nl, 0, s1 - s0, OE_WH, bx, by);
+#endif
+#undef OE_WINDOW
+#undef OE_WH
+
+#if OE_LAYERS
+        /* Every layer over the window, with its own state */
+        for (int k = 0; k < nlay; k++) {
+        double h = hl[k];
+        double ax = lax[k], ay = lay[k];
+        int m = ml[k];
+        OE_REAL *x0 = x0l + (size_t)k * nmax, *y0 = y0l + (size_t)k * nmax;
+#endif
+        for (int i = e0; i < e1; i++) {
+            int p = OE_IX(i), q = OE_IX(i + 1);
+            double p1x = x[p], p1y = y[p], p2x = x[q], p2y = y[q];
+#if OE_LAYERS
+            double Bx = p2x + h * bx[i - s0], By = p2y + h * by[i - s0];
+#else
+            double Bx = bx[i - s0], By = by[i - s0];
+#endif
+#if OE_RESUME
+            mo[i - i0] = m;
+#endif
+
+            /* Zero length segment */
+            if (p2x == p1x && p2y == p1y) continue;
+
+            /* Folded segment: B is dropped and A is kept */
+            if (!oe_diagonals_cross(p1x, p1y, Bx, By, p2x, p2y, ax, ay)) {
+                OE_TRACE(PT_FOLD, i, m);
+#if OE_SINK == OE_CALLBACK
+                cb->triangulo(ctx, p, q, ax, ay);
+#endif
+                continue;
+            }
+
+#if OE_FILTER
+            /* Squared segment lengths for geometric filtering */
+            double l2 = (Bx - ax) * (Bx - ax) + (By - ay) * (By - ay);
+            double l1 = 1e300;
+            if (i < n - 2) {
+                int r = OE_IX(i + 2);
+                l1 = (x[r] - p1x) * (x[r] - p1x) + (y[r] - p1y) * (y[r] - p1y);
+            }
+
+            if (l2 < lmin2 && l2 < l1) {
+                /* Skip point B — too short to be significant */
+                OE_TRACE(PT_SKIP, i, m);
+#if OE_SINK == OE_CALLBACK
+                cb->triangulo(ctx, p, q, ax, ay);
+#endif
+                continue;
+            }
+
+            if (l2 > lmax2) {
+                /* Insert a point C midway between A and B, moved
+                   along the segment normal to distance h */
+                double dx = p2x - p1x, dy = p2y - p1y;
+                double il = 1.0 / sqrt(dx * dx + dy * dy);
+                double nx = -dy * il, ny = dx * il;
+                double mx = 0.5 * (ax + Bx), my = 0.5 * (ay + By);
+                double s = h - ((mx - p1x) * nx + (my - p1y) * ny);
+                double cx = mx + s * nx, cy = my + s * ny;
+#if OE_SINK == OE_BUFFER
+                OE_STORE(i, cx, cy);
+#else
+                cb->punto(ctx, cx, cy);
+                m++;
+#endif
+                OE_TRACE(PT_INSERT, i, m);
+            }
+#endif
+
+            /* Emit point B */
+#if OE_SINK == OE_BUFFER
+            OE_STORE(i, Bx, By);
+            ax = Bx; ay = By;
+#else
+            if (cb->cuadrilatero(ctx, p, q, ax, ay, Bx, By)) { ax = Bx; ay = By; }
+            m++;
+#endif
+            OE_TRACE(PT_APPEND, i, m);
+        }
+#if OE_LAYERS
+        lax[k] = ax; lay[k] = ay;
+        ml[k] = m;
+        }
+#endif
+    }
+
+#if OE_LAYERS
+    for (int k = 0; k < nlay; k++) m += ml[k];
+#endif
+
+#if OE_RESUME
+    mo[i1 - i0] = m;
+    a[0] = ax;
+    a[1] = ay;
+#endif
+    OE_TRACE(PT_END, OE_LAST, m);
+    return m;
+}
+
+#undef OE_NAME
+#undef OE_INPUT
+#undef OE_SINK
+#undef OE_FILTER
+#undef OE_RESUME
+#undef OE_RESUME_PARAMS
+#undef OE_LAYERS
+#undef OE_FLOAT
+#undef OE_REAL
+#undef OE_POINTS_WINDOW
+#undef OE_ROUND
+#undef OE_H_PARAMS
+#undef OE_LAYER_PARAMS
+#undef OE_FIRST
+#undef OE_LAST
+#undef OE_TRACE
+#undef OE_IX
+#undef OE_IND_PARAM
+#undef OE_FILTER_PARAMS
+#undef OE_SINK_PARAMS
+#undef OE_NMAX
+#ifdef OE_STORE
+#undef OE_STORE
+#endif
+
+#endif /* OE_NAME */
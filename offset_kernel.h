@@ -0,0 +1,292 @@
+#ifndef OFFSET_KERNEL_H
+#define OFFSET_KERNEL_H
+
+#include <math.h>
+#if !defined(GRID2D_NO_SIMD) && (defined(__AVX__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+/*-------------------------------------------------------------
+  Batch kernel for bisector normals and offset points
+  -------------------------------------------------------------
+  The offset routines need, for every vertex of the curve, the
+  unit bisector normal of the two adjacent segments and the
+  candidate offset point B = P + h * N. This header computes them
+  for a whole window of vertices in one sweep over structure of
+  arrays input, so that the sequential intersection and filtering
+  logic only has to read the precomputed points.
+
+  The normal is the left-hand normal (-ty, tx) of the sum of the
+  two unit tangents; right-hand offsets use a negative h. A zero
+  length segment contributes no tangent, and a vertex whose two
+  tangents cancel out gets B = P.
+
+  The _normal variants return h * N instead of P + h * N; with
+  h = 1 they give the unit normals, from which the multi-layer
+  offset (build_parallel_multi, offset1.c) builds the points of
+  every layer.
+
+  The _f variants take float coordinates and compute in float,
+  eight lanes per AVX register instead of four (see OE_FLOAT in
+  offset_engine.h); the end point is still computed in double.
+
+  AVX is used when available, then SSE2, then plain scalar code.
+  Define GRID2D_NO_SIMD to force the scalar version.
+-------------------------------------------------------------*/
+
+#define OFFSET_BLOCK 256    // vertices per window in the offset loops
+
+/*-------------------------------------------------------------
+  Scalar version for one interior vertex (x1,y1)
+-------------------------------------------------------------*/
+static inline void offset_bisector_1(
+    double x0, double y0, double x1, double y1, double x2, double y2,
+    double h, double *bx, double *by)
+{
+    double dx1 = x1 - x0, dy1 = y1 - y0;
+    double dx2 = x2 - x1, dy2 = y2 - y1;
+    double l1 = sqrt(dx1*dx1 + dy1*dy1);
+    double l2 = sqrt(dx2*dx2 + dy2*dy2);
+    double i1 = l1 > 0.0 ? 1.0 / l1 : 0.0;
+    double i2 = l2 > 0.0 ? 1.0 / l2 : 0.0;
+    double nx = -(dy1*i1 + dy2*i2);
+    double ny =  (dx1*i1 + dx2*i2);
+    double nl = sqrt(nx*nx + ny*ny);
+    double s = nl > 0.0 ? h / nl : 0.0;
+    *bx = x1 + s * nx;
+    *by = y1 + s * ny;
+}
+
+/*-------------------------------------------------------------
+  Same, returning h * N without the vertex
+-------------------------------------------------------------*/
+static inline void offset_normal_1(
+    double x0, double y0, double x1, double y1, double x2, double y2,
+    double h, double *nx_, double *ny_)
+{
+    double dx1 = x1 - x0, dy1 = y1 - y0;
+    double dx2 = x2 - x1, dy2 = y2 - y1;
+    double l1 = sqrt(dx1*dx1 + dy1*dy1);
+    double l2 = sqrt(dx2*dx2 + dy2*dy2);
+    double i1 = l1 > 0.0 ? 1.0 / l1 : 0.0;
+    double i2 = l2 > 0.0 ? 1.0 / l2 : 0.0;
+    double nx = -(dy1*i1 + dy2*i2);
+    double ny =  (dx1*i1 + dx2*i2);
+    double nl = sqrt(nx*nx + ny*ny);
+    double s = nl > 0.0 ? h / nl : 0.0;
+    *nx_ = s * nx;
+    *ny_ = s * ny;
+}
+
+/*-------------------------------------------------------------
+  Offset point of (px,py) along the normal of segment (x0,y0)-(x1,y1)
+  Used at the two end vertices of the curve.
+-------------------------------------------------------------*/
+static inline void offset_end_point(
+    double x0, double y0, double x1, double y1, double px, double py,
+    double h, double *bx, double *by)
+{
+    double dx = x1 - x0, dy = y1 - y0;
+    double l = sqrt(dx*dx + dy*dy);
+    double s = l > 0.0 ? h / l : 0.0;
+    *bx = px - s * dy;
+    *by = py + s * dx;
+}
+
+/*-------------------------------------------------------------
+  Offset points of k interior vertices
+  The window x[0..k+1], y[0..k+1] holds k+2 consecutive points and
+  (bx[j], by[j]) receives the offset point of vertex j+1, or only
+  h times its normal when org is 0 (a constant in every caller,
+  so that the choice is folded away).
+-------------------------------------------------------------*/
+static inline void offset_bisector_kernel(
+    const double *x, const double *y, int k, double h, int org,
+    double *bx, double *by)
+{
+    int j = 0;
+#if !defined(GRID2D_NO_SIMD) && defined(__AVX__)
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d vh = _mm256_set1_pd(h);
+    for (; j + 4 <= k; j += 4) {
+        __m256d x0 = _mm256_loadu_pd(x + j),     y0 = _mm256_loadu_pd(y + j);
+        __m256d x1 = _mm256_loadu_pd(x + j + 1), y1 = _mm256_loadu_pd(y + j + 1);
+        __m256d x2 = _mm256_loadu_pd(x + j + 2), y2 = _mm256_loadu_pd(y + j + 2);
+        __m256d dx1 = _mm256_sub_pd(x1, x0), dy1 = _mm256_sub_pd(y1, y0);
+        __m256d dx2 = _mm256_sub_pd(x2, x1), dy2 = _mm256_sub_pd(y2, y1);
+        __m256d l1 = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx1, dx1), _mm256_mul_pd(dy1, dy1)));
+        __m256d l2 = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx2, dx2), _mm256_mul_pd(dy2, dy2)));
+        __m256d i1 = _mm256_and_pd(_mm256_div_pd(one, l1), _mm256_cmp_pd(l1, zero, _CMP_GT_OQ));
+        __m256d i2 = _mm256_and_pd(_mm256_div_pd(one, l2), _mm256_cmp_pd(l2, zero, _CMP_GT_OQ));
+        __m256d tx = _mm256_add_pd(_mm256_mul_pd(dx1, i1), _mm256_mul_pd(dx2, i2));
+        __m256d ty = _mm256_add_pd(_mm256_mul_pd(dy1, i1), _mm256_mul_pd(dy2, i2));
+        __m256d nl = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(tx, tx), _mm256_mul_pd(ty, ty)));
+        __m256d s = _mm256_and_pd(_mm256_div_pd(vh, nl), _mm256_cmp_pd(nl, zero, _CMP_GT_OQ));
+        if (!org) { x1 = zero; y1 = zero; }
+        _mm256_storeu_pd(bx + j, _mm256_sub_pd(x1, _mm256_mul_pd(s, ty)));
+        _mm256_storeu_pd(by + j, _mm256_add_pd(y1, _mm256_mul_pd(s, tx)));
+    }
+#elif !defined(GRID2D_NO_SIMD) && defined(__SSE2__)
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d vh = _mm_set1_pd(h);
+    for (; j + 2 <= k; j += 2) {
+        __m128d x0 = _mm_loadu_pd(x + j),     y0 = _mm_loadu_pd(y + j);
+        __m128d x1 = _mm_loadu_pd(x + j + 1), y1 = _mm_loadu_pd(y + j + 1);
+        __m128d x2 = _mm_loadu_pd(x + j + 2), y2 = _mm_loadu_pd(y + j + 2);
+        __m128d dx1 = _mm_sub_pd(x1, x0), dy1 = _mm_sub_pd(y1, y0);
+        __m128d dx2 = _mm_sub_pd(x2, x1), dy2 = _mm_sub_pd(y2, y1);
+        __m128d l1 = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx1, dx1), _mm_mul_pd(dy1, dy1)));
+        __m128d l2 = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx2, dx2), _mm_mul_pd(dy2, dy2)));
+        __m128d i1 = _mm_and_pd(_mm_div_pd(one, l1), _mm_cmpgt_pd(l1, zero));
+        __m128d i2 = _mm_and_pd(_mm_div_pd(one, l2), _mm_cmpgt_pd(l2, zero));
+        __m128d tx = _mm_add_pd(_mm_mul_pd(dx1, i1), _mm_mul_pd(dx2, i2));
+        __m128d ty = _mm_add_pd(_mm_mul_pd(dy1, i1), _mm_mul_pd(dy2, i2));
+        __m128d nl = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(tx, tx), _mm_mul_pd(ty, ty)));
+        __m128d s = _mm_and_pd(_mm_div_pd(vh, nl), _mm_cmpgt_pd(nl, zero));
+        if (!org) { x1 = zero; y1 = zero; }
+        _mm_storeu_pd(bx + j, _mm_sub_pd(x1, _mm_mul_pd(s, ty)));
+        _mm_storeu_pd(by + j, _mm_add_pd(y1, _mm_mul_pd(s, tx)));
+    }
+#endif
+    for (; j < k; j++) {
+        if (org) offset_bisector_1(x[j], y[j], x[j+1], y[j+1], x[j+2], y[j+2], h, bx + j, by + j);
+        else     offset_normal_1(x[j], y[j], x[j+1], y[j+1], x[j+2], y[j+2], h, bx + j, by + j);
+    }
+}
+
+static inline void offset_bisector_batch(
+    const double *x, const double *y, int k, double h,
+    double *bx, double *by)
+{
+    offset_bisector_kernel(x, y, k, h, 1, bx, by);
+}
+
+static inline void offset_normal_batch(
+    const double *x, const double *y, int k, double h,
+    double *nx, double *ny)
+{
+    offset_bisector_kernel(x, y, k, h, 0, nx, ny);
+}
+
+/*-------------------------------------------------------------
+  Offset points B of the segments i in [i0, i1) of a curve
+  with n points: (bx[i-i0], by[i-i0]) is the offset point of
+  vertex i+1, with the one-segment normal at the last vertex.
+  i1 - i0 must not exceed OFFSET_BLOCK.
+-------------------------------------------------------------*/
+static inline void offset_points_window(
+    const double *x, const double *y, int n, int i0, int i1, double h,
+    double *bx, double *by)
+{
+    int k = (i1 < n - 2 ? i1 : n - 2) - i0;
+    if (k > 0) offset_bisector_batch(x + i0, y + i0, k, h, bx, by);
+    if (i1 == n - 1)
+        offset_end_point(x[n-2], y[n-2], x[n-1], y[n-1], x[n-1], y[n-1], h,
+                         bx + (n - 2 - i0), by + (n - 2 - i0));
+}
+
+/*-------------------------------------------------------------
+  Same, with h times the normals (nx[i-i0], ny[i-i0]) of the
+  vertices i+1 instead of the points
+-------------------------------------------------------------*/
+static inline void offset_normals_window(
+    const double *x, const double *y, int n, int i0, int i1, double h,
+    double *nx, double *ny)
+{
+    int k = (i1 < n - 2 ? i1 : n - 2) - i0;
+    if (k > 0) offset_normal_batch(x + i0, y + i0, k, h, nx, ny);
+    if (i1 == n - 1)
+        offset_end_point(x[n-2], y[n-2], x[n-1], y[n-1], 0.0, 0.0, h,
+                         nx + (n - 2 - i0), ny + (n - 2 - i0));
+}
+
+/*-------------------------------------------------------------
+  Single precision versions
+-------------------------------------------------------------*/
+static inline void offset_bisector_1f(
+    float x0, float y0, float x1, float y1, float x2, float y2,
+    float h, float *bx, float *by)
+{
+    float dx1 = x1 - x0, dy1 = y1 - y0;
+    float dx2 = x2 - x1, dy2 = y2 - y1;
+    float l1 = sqrtf(dx1*dx1 + dy1*dy1);
+    float l2 = sqrtf(dx2*dx2 + dy2*dy2);
+    float i1 = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+    float i2 = l2 > 0.0f ? 1.0f / l2 : 0.0f;
+    float nx = -(dy1*i1 + dy2*i2);
+    float ny =  (dx1*i1 + dx2*i2);
+    float nl = sqrtf(nx*nx + ny*ny);
+    float s = nl > 0.0f ? h / nl : 0.0f;
+    *bx = x1 + s * nx;
+    *by = y1 + s * ny;
+}
+
+static inline void offset_bisector_batch_f(
+    const float *x, const float *y, int k, float h,
+    float *bx, float *by)
+{
+    int j = 0;
+#if !defined(GRID2D_NO_SIMD) && defined(__AVX__)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 vh = _mm256_set1_ps(h);
+    for (; j + 8 <= k; j += 8) {
+        __m256 x0 = _mm256_loadu_ps(x + j),     y0 = _mm256_loadu_ps(y + j);
+        __m256 x1 = _mm256_loadu_ps(x + j + 1), y1 = _mm256_loadu_ps(y + j + 1);
+        __m256 x2 = _mm256_loadu_ps(x + j + 2), y2 = _mm256_loadu_ps(y + j + 2);
+        __m256 dx1 = _mm256_sub_ps(x1, x0), dy1 = _mm256_sub_ps(y1, y0);
+        __m256 dx2 = _mm256_sub_ps(x2, x1), dy2 = _mm256_sub_ps(y2, y1);
+        __m256 l1 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx1, dx1), _mm256_mul_ps(dy1, dy1)));
+        __m256 l2 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx2, dx2), _mm256_mul_ps(dy2, dy2)));
+        __m256 i1 = _mm256_and_ps(_mm256_div_ps(one, l1), _mm256_cmp_ps(l1, zero, _CMP_GT_OQ));
+        __m256 i2 = _mm256_and_ps(_mm256_div_ps(one, l2), _mm256_cmp_ps(l2, zero, _CMP_GT_OQ));
+        __m256 tx = _mm256_add_ps(_mm256_mul_ps(dx1, i1), _mm256_mul_ps(dx2, i2));
+        __m256 ty = _mm256_add_ps(_mm256_mul_ps(dy1, i1), _mm256_mul_ps(dy2, i2));
+        __m256 nl = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)));
+        __m256 s = _mm256_and_ps(_mm256_div_ps(vh, nl), _mm256_cmp_ps(nl, zero, _CMP_GT_OQ));
+        _mm256_storeu_ps(bx + j, _mm256_sub_ps(x1, _mm256_mul_ps(s, ty)));
+        _mm256_storeu_ps(by + j, _mm256_add_ps(y1, _mm256_mul_ps(s, tx)));
+    }
+#elif !defined(GRID2D_NO_SIMD) && defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 vh = _mm_set1_ps(h);
+    for (; j + 4 <= k; j += 4) {
+        __m128 x0 = _mm_loadu_ps(x + j),     y0 = _mm_loadu_ps(y + j);
+        __m128 x1 = _mm_loadu_ps(x + j + 1), y1 = _mm_loadu_ps(y + j + 1);
+        __m128 x2 = _mm_loadu_ps(x + j + 2), y2 = _mm_loadu_ps(y + j + 2);
+        __m128 dx1 = _mm_sub_ps(x1, x0), dy1 = _mm_sub_ps(y1, y0);
+        __m128 dx2 = _mm_sub_ps(x2, x1), dy2 = _mm_sub_ps(y2, y1);
+        __m128 l1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx1, dx1), _mm_mul_ps(dy1, dy1)));
+        __m128 l2 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx2, dx2), _mm_mul_ps(dy2, dy2)));
+        __m128 i1 = _mm_and_ps(_mm_div_ps(one, l1), _mm_cmpgt_ps(l1, zero));
+        __m128 i2 = _mm_and_ps(_mm_div_ps(one, l2), _mm_cmpgt_ps(l2, zero));
+        __m128 tx = _mm_add_ps(_mm_mul_ps(dx1, i1), _mm_mul_ps(dx2, i2));
+        __m128 ty = _mm_add_ps(_mm_mul_ps(dy1, i1), _mm_mul_ps(dy2, i2));
+        __m128 nl = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)));
+        __m128 s = _mm_and_ps(_mm_div_ps(vh, nl), _mm_cmpgt_ps(nl, zero));
+        _mm_storeu_ps(bx + j, _mm_sub_ps(x1, _mm_mul_ps(s, ty)));
+        _mm_storeu_ps(by + j, _mm_add_ps(y1, _mm_mul_ps(s, tx)));
+    }
+#endif
+    for (; j < k; j++)
+        offset_bisector_1f(x[j], y[j], x[j+1], y[j+1], x[j+2], y[j+2], h, bx + j, by + j);
+}
+
+static inline void offset_points_window_f(
+    const float *x, const float *y, int n, int i0, int i1, double h,
+    float *bx, float *by)
+{
+    int k = (i1 < n - 2 ? i1 : n - 2) - i0;
+    if (k > 0) offset_bisector_batch_f(x + i0, y + i0, k, (float)h, bx, by);
+    if (i1 == n - 1) {
+        double ex, ey;
+        offset_end_point(x[n-2], y[n-2], x[n-1], y[n-1], x[n-1], y[n-1], h, &ex, &ey);
+        bx[n - 2 - i0] = (float)ex;
+        by[n - 2 - i0] = (float)ey;
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include <math.h>
+
+/*-------------------------------------------------------------
+  Filtered exact orientation predicate
+  -------------------------------------------------------------
+  orient2d(a, b, c) returns a value with the sign of the
+  determinant
+
+      | bx-ax  cx-ax |
+      | by-ay  cy-ay |
+
+  positive when a, b, c turn counterclockwise, negative when
+  they turn clockwise and zero when they are collinear. The sign
+  is always exact.
+
+  The determinant is first computed in plain double precision.
+  If it is larger than the forward error bound of that
+  computation (Shewchuk's ccwerrboundA, (3 + 16 eps) eps times
+  the sum of the magnitudes of the two products), its sign is
+  already right and it is returned as is. This is the common
+  case and costs about as much as the plain formula.
+
+  Otherwise the determinant is expanded into the six products of
+  input coordinates, each one split exactly into a sum of two
+  doubles with fma, and the twelve terms are added into a non
+  overlapping expansion (Shewchuk's Grow-Expansion). Its largest
+  component has the sign of the exact determinant and is
+  returned. Only near-degenerate triples take this path.
+-------------------------------------------------------------*/
+
+#define PRED_EPS       1.1102230246251565e-16   // 2^-53
+#define PRED_ERRBOUND  ((3.0 + 16.0 * PRED_EPS) * PRED_EPS)
+
+/*-------------------------------------------------------------
+  Helper: add q to the non overlapping expansion e[0..n-1]
+  (increasing magnitude) dropping zero components; returns the
+  new length
+-------------------------------------------------------------*/
+static inline int pred_grow(double *e, int n, double q)
+{
+    int m = 0;
+    for (int k = 0; k < n; k++) {
+        double s = q + e[k];                    // Two-Sum
+        double bv = s - q;
+        double err = (q - (s - bv)) + (e[k] - bv);
+        if (err != 0.0) e[m++] = err;
+        q = s;
+    }
+    if (q != 0.0 || m == 0) e[m++] = q;
+    return m;
+}
+
+/*-------------------------------------------------------------
+  Exact sign of the determinant, for the uncertain cases
+-------------------------------------------------------------*/
+static double orient2d_exact(
+    double ax, double ay, double bx, double by, double cx, double cy)
+{
+    /* det = ax*by - ax*cy - ay*bx + ay*cx + bx*cy - by*cx */
+    double u[6] = { ax, -ax, -ay, ay, bx, -by };
+    double v[6] = { by,  cy,  bx, cx, cy,  cx };
+    double e[12];
+    int n = 0;
+    for (int k = 0; k < 6; k++) {
+        double p = u[k] * v[k];
+        double t = fma(u[k], v[k], -p);        // Two-Product
+        n = pred_grow(e, n, t);
+        n = pred_grow(e, n, p);
+    }
+    return e[n - 1];
+}
+
+/*-------------------------------------------------------------
+  Orientation of the triple (a, b, c)
+-------------------------------------------------------------*/
+static inline double orient2d(
+    double ax, double ay, double bx, double by, double cx, double cy)
+{
+    double l = (bx - ax) * (cy - ay);
+    double r = (by - ay) * (cx - ax);
+    double det = l - r;
+    double sum;
+
+    if (l > 0.0) {
+        if (r <= 0.0) return det;               // No cancellation
+        sum = l + r;
+    } else if (l < 0.0) {
+        if (r >= 0.0) return det;
+        sum = -l - r;
+    } else {
+        return det;                             // det = -r exactly
+    }
+
+    if (fabs(det) >= PRED_ERRBOUND * sum) return det;
+    return orient2d_exact(ax, ay, bx, by, cx, cy);
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+#include "offset_engine.h"
+
+/*-------------------------------------------------------------
+  Quad-dominant band mesher
+  -------------------------------------------------------------
+  Builds the band between a polyline and its offset curve in the
+  same pass that builds the offset, from the decisions the offset
+  engine already takes for every segment (the cuadrilatero and
+  triangulo routines of its callback sink):
+
+  - A valid point B closes the quad P_i, P_{i+1}, B, A.
+  - A folded segment (B dropped) or a skipped one (AB shorter
+    than lmin) leaves the triangle P_i, P_{i+1}, A.
+  - When a point C was inserted between A and B, the pentagon
+    P_i, P_{i+1}, B, C, A is cut into the quad P_i, P_{i+1}, B, C
+    and the triangle P_i, C, A, or into the triangle
+    P_{i+1}, B, C and the quad P_i, P_{i+1}, C, A when the first
+    quad would not be convex.
+
+  Each segment gives at most one quad and one triangle, so the
+  band has about half the elements of the zipped one
+  (fill_between) and needs no second pass over the curves.
+
+  Vertices are numbered as in the bands of fill_between: the
+  base curve 0 .. n-1, then the offset points n .. nv-1, in one
+  buffer xv, yv. The offset is the one of build_parallel_curve
+  (lmin/lmax filter included) without remove_self_intersections,
+  so h must stay below the radius of curvature of the curve, as
+  for the offset itself. The elements are counter-clockwise for
+  either sign of h. A base point repeated (zero length segment)
+  is replaced by its first copy, so that the mesh is conforming.
+
+  Output buffers, given by the caller:
+    xv, yv  3n - 1 vertices
+    quad    4 (n - 1) indices
+    tri     3 (n - 1) indices
+  Returns the number of vertices, or 0 if the curve has no
+  offset (n < 2, or a zero length first segment).
+-------------------------------------------------------------*/
+
+typedef struct {
+    const double *x, *y;    // base polyline
+    double *xv, *yv;        // vertex buffer
+    int nv;                 // vertices stored
+    int a, c;               // offset vertex A, pending point C (-1 if none)
+    int pb;                 // base vertex ending the last segment (-1 at the start)
+    int flip;               // h < 0: reverse the elements
+    int *quad, nq;          // quads stored
+    int *tri, nt;           // triangles stored
+} QuadBand;
+
+static inline void put_quad(QuadBand *q, int v0, int v1, int v2, int v3) {
+    int *e = q->quad + 4 * q->nq++;
+    if (q->flip) { e[0] = v3; e[1] = v2; e[2] = v1; e[3] = v0; }
+    else         { e[0] = v0; e[1] = v1; e[2] = v2; e[3] = v3; }
+}
+
+static inline void put_tri(QuadBand *q, int v0, int v1, int v2) {
+    int *e = q->tri + 3 * q->nt++;
+    if (q->flip) { e[0] = v2; e[1] = v1; e[2] = v0; }
+    else         { e[0] = v0; e[1] = v1; e[2] = v2; }
+}
+
+/* First vertex of a segment: the skipped segments before it have
+   zero length, so its start coincides with the end of the last one */
+static inline int seg_start(QuadBand *q, int i0, int i1) {
+    int p = q->pb >= 0 ? q->pb : i0;
+    q->pb = i1;
+    return p;
+}
+
+/*-------------------------------------------------------------
+  Routines of the callback sink
+-------------------------------------------------------------*/
+static inline void qb_punto(void *ctx, double ax, double ay) {
+    QuadBand *q = ctx;
+    int v = q->nv++;
+    q->xv[v] = ax;
+    q->yv[v] = ay;
+    if (q->a < 0) q->a = v;       // first point
+    else q->c = v;                // point C, before its B
+}
+
+static inline int qb_cuadrilatero(void *ctx, int i0, int i1,
+                                  double ax, double ay, double bx, double by) {
+    QuadBand *q = ctx;
+    int p = seg_start(q, i0, i1);
+    int b = q->nv++;
+    q->xv[b] = bx;
+    q->yv[b] = by;
+    if (q->c < 0) {
+        put_quad(q, p, i1, b, q->a);
+    } else {
+        int c = q->c;
+        double cx = q->xv[c], cy = q->yv[c];
+        if (oe_diagonals_cross(q->x[p], q->y[p], bx, by, q->x[i1], q->y[i1], cx, cy)) {
+            put_quad(q, p, i1, b, c);
+            put_tri(q, p, c, q->a);
+        } else {
+            put_tri(q, i1, b, c);
+            put_quad(q, p, i1, c, q->a);
+        }
+        q->c = -1;
+    }
+    (void)ax; (void)ay;
+    q->a = b;
+    return 1;
+}
+
+static inline void qb_triangulo(void *ctx, int i0, int i1, double ax, double ay) {
+    QuadBand *q = ctx;
+    int p = seg_start(q, i0, i1);
+    put_tri(q, p, i1, q->a);
+    (void)ax; (void)ay;
+}
+
+/*-------------------------------------------------------------
+  Offset loop: direct input, callback output, lmin/lmax filter
+-------------------------------------------------------------*/
+#define OE_NAME quad_engine
+#define OE_INPUT OE_DIRECT
+#define OE_SINK OE_CALLBACK
+#define OE_FILTER 1
+#include "offset_engine.h"
+
+static const OffsetCallbacks quad_callbacks = { qb_punto, qb_cuadrilatero, qb_triangulo };
+
+int build_quad_band(
+    double *x, double *y, int n,     // Base polyline
+    double h,                        // Offset distance
+    double lmin, double lmax,        // Length thresholds
+    double *xv, double *yv,          // Output: vertices (3n - 1)
+    int *quad, int *nq,              // Output: quads (4 indices each)
+    int *tri, int *nt                // Output: triangles (3 indices each)
+) {
+    QuadBand q = { x, y, xv, yv, n, -1, -1, -1, h < 0, quad, 0, tri, 0 };
+    *nq = 0;
+    *nt = 0;
+    if (n < 2) return 0;
+
+    memcpy(xv, x, n * sizeof(double));
+    memcpy(yv, y, n * sizeof(double));
+    if (quad_engine(x, y, n, h, lmin, lmax, &quad_callbacks, &q) == 0) return 0;
+
+    *nq = q.nq;
+    *nt = q.nt;
+    return q.nv;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the quad-dominant band mesher
+  Inputs (D*):
+    x, y       : double arrays with the base polyline
+    h          : double scalar, offset distance
+    lmin, lmax : double scalars, length thresholds
+  Returns: D list with the vertex coordinates xv, yv, the quads
+  quad (4 indices per quad) and the triangles tri (3 indices
+  per triangle, possibly empty), or DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_quad_band5(D *x, D *y, D *h, D *lmin, D *lmax) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        h->t != D_TIPO_DOUBLE || lmin->t != D_TIPO_DOUBLE ||
+        lmax->t != D_TIPO_DOUBLE) {
+        DError("quad_band : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || x->n < 2 || h->n != 1 || lmin->n != 1 || lmax->n != 1) {
+        DError("quad_band : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(h);
+        DLibera(lmin);
+        DLibera(lmax);
+        return DCreaNulo();
+    }
+
+    // Mesh into the arena of the shared workspace, then copy the
+    // result to D structures of the exact size
+    int n = x->n;
+    Grid2DWork *w = grid2d_d_work();
+    grid2d_work_reset(w);
+    double *xv = grid2d_work_alloc(w, (3 * (size_t)n - 1) * sizeof(double));
+    double *yv = grid2d_work_alloc(w, (3 * (size_t)n - 1) * sizeof(double));
+    int *quad = grid2d_work_alloc(w, 4 * (size_t)(n - 1) * sizeof(int));
+    int *tri = grid2d_work_alloc(w, 3 * (size_t)(n - 1) * sizeof(int));
+
+    int nv = 0, nq = 0, nt = 0;
+    if (xv && yv && quad && tri)
+        nv = build_quad_band(x->p.d, y->p.d, n, h->p.d[0],
+                             lmin->p.d[0], lmax->p.d[0],
+                             xv, yv, quad, &nq, tri, &nt);
+
+    D *output;
+    if (nv > 0) {
+        D *dx = DCreaDouble(nv);
+        D *dy = DCreaDouble(nv);
+        D *dq = DCreaInt(4 * nq);
+        D *dt = DCreaInt(3 * nt);
+        memcpy(dx->p.d, xv, nv * sizeof(double));
+        memcpy(dy->p.d, yv, nv * sizeof(double));
+        memcpy(dq->p.i, quad, 4 * nq * sizeof(int));
+        memcpy(dt->p.i, tri, 3 * nt * sizeof(int));
+
+        output = DCreaLista();
+        DInserta(output, dx);
+        DInserta(output, dy);
+        DInserta(output, dq);
+        DInserta(output, dt);
+    } else {
+        output = DCreaNulo();
+    }
+
+    // Free all input arguments
+    DLibera(x);
+    DLibera(y);
+    DLibera(h);
+    DLibera(lmin);
+    DLibera(lmax);
+
+    return output;
+}
+
+#endif
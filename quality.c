@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+#include "predicates.h"
+
+/*-------------------------------------------------------------
+  Edge-flip quality pass
+  -------------------------------------------------------------
+  The zipper of fill_between chooses every triangle greedily
+  (shorter of the two diagonals BC, AD), which leaves slivers
+  where the curves bend sharply. This pass improves a finished
+  triangulation by edge flips, keeping its vertices and its
+  boundary (the two curves of a band are never changed):
+
+  - The half-edge adjacency is built in linear time from the
+    triangles incident to each vertex: nbr[3t+k] is the half-edge
+    twin of edge k of triangle t (from t[k] to t[k+1]), -1 on the
+    boundary.
+  - Every interior edge goes through a work queue. An edge is
+    flipped when its quad is convex and
+      FLIP_DELAUNAY   the opposite vertex lies inside the
+                      circumcircle of the triangle (in-circle
+                      test with Shewchuk's error bound: a doubtful
+                      sign is read as cocircular and not flipped,
+                      so the pass always terminates)
+      FLIP_MIN_ANGLE  the smallest angle of the two triangles
+                      grows
+    and the four outer edges of a flipped quad are queued again.
+  - The triangles are split in chunks of QUALITY_CHUNK
+    consecutive triangles (the zipper emits them along the band,
+    so a chunk is a stretch of band, and the bands of
+    build_band_layers are consecutive too). The chunks are
+    processed in parallel with OpenMP, each flipping only quads
+    whose triangles and outer neighbours all belong to it, so
+    that no two threads touch the same triangle; the edges left
+    over at the seams are then processed in a final sequential
+    pass.
+
+  quality_histogram counts the triangles by smallest angle, in
+  QUALITY_BINS bins of 60 / QUALITY_BINS degrees, so that the
+  quality before and after the pass can be compared.
+
+  The scratch arrays are taken from the arena of a workspace
+  (see workspace.c).
+-------------------------------------------------------------*/
+
+#define QUALITY_CHUNK 8192     // triangles per parallel chunk
+
+#define ICC_ERRBOUND ((10.0 + 96.0 * PRED_EPS) * PRED_EPS)
+
+/*-------------------------------------------------------------
+  Helper: sine of the smallest angle of a triangle, the angle
+  opposite its shortest edge (at most 60 degrees, so the sine
+  orders the triangles as the angle does)
+-------------------------------------------------------------*/
+static double min_angle_sin(const double *x, const double *y, int a, int b, int c) {
+    double ux = x[b] - x[a], uy = y[b] - y[a];
+    double vx = x[c] - x[b], vy = y[c] - y[b];
+    double wx = x[a] - x[c], wy = y[a] - y[c];
+    double lu = ux * ux + uy * uy, lv = vx * vx + vy * vy, lw = wx * wx + wy * wy;
+    double cr = fabs(ux * wy - uy * wx);
+    double pr = lu < lv ? (lu < lw ? lv * lw : lu * lv) : (lv < lw ? lu * lw : lu * lv);
+    return pr > 0.0 ? cr / sqrt(pr) : 0.0;
+}
+
+/*-------------------------------------------------------------
+  Triangles by smallest angle: hist[QUALITY_BINS]
+-------------------------------------------------------------*/
+void quality_histogram(const double *x, const double *y, const int *tri, int nt, int *hist) {
+    double edge[QUALITY_BINS];       // sines of the upper bin edges
+    for (int b = 0; b < QUALITY_BINS; b++) edge[b] = sin((b + 1) * (M_PI / 3.0) / QUALITY_BINS);
+    memset(hist, 0, QUALITY_BINS * sizeof(int));
+    for (int t = 0; t < nt; t++) {
+        const int *v = tri + 3 * t;
+        double sn = min_angle_sin(x, y, v[0], v[1], v[2]);
+        int b = 0;
+        while (b < QUALITY_BINS - 1 && sn >= edge[b]) b++;
+        hist[b]++;
+    }
+}
+
+/*-------------------------------------------------------------
+  Half-edge adjacency of a triangulation with nv vertices:
+  nbr[3t+k] = 3s+l when edge k of t is edge l of s, or -1
+  Returns 0 if out of memory.
+-------------------------------------------------------------*/
+int triangle_adjacency(Grid2DWork *w, const int *tri, int nt, int nv, int *nbr) {
+    int *start = grid2d_work_alloc(w, (nv + 1) * sizeof(int));
+    int *inc = grid2d_work_alloc(w, 3 * (size_t)nt * sizeof(int));
+    if (!start || !inc) return 0;
+
+    /* ---- Corners at each vertex (CSR), as half-edges 3t+k ---- */
+    memset(start, 0, (nv + 1) * sizeof(int));
+    for (size_t q = 0; q < 3 * (size_t)nt; q++) start[tri[q] + 1]++;
+    for (int v = 0; v < nv; v++) start[v+1] += start[v];
+    for (int q = 0; q < 3 * nt; q++) inc[start[tri[q]]++] = q;
+    for (int v = nv; v > 0; v--) start[v] = start[v-1];
+    start[0] = 0;
+
+    /* ---- Twin of u -> v: the corner at v whose edge ends at u ---- */
+    static const int next[3] = { 1, 2, 0 };
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < nt; t++) {
+        for (int k = 0; k < 3; k++) {
+            int u = tri[3*t+k], v = tri[3*t + next[k]], tw = -1;
+            for (int q = start[v]; q < start[v+1]; q++) {
+                int f = inc[q];
+                if (tri[f - f % 3 + next[f % 3]] == u) { tw = f; break; }
+            }
+            nbr[3*t+k] = tw;
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Helper: should the edge e = (t, k) be flipped?
+  t = (u, v, p) and its twin (v, u, q) form the quad u, q, v, p.
+-------------------------------------------------------------*/
+static int want_flip(const double *x, const double *y, const int *tri, const int *nbr,
+                     int e, int method) {
+    int f = nbr[e];
+    if (f < 0) return 0;
+    int t = e / 3, k = e % 3, s = f / 3, l = f % 3;
+    int u = tri[3*t+k], v = tri[3*t + (k+1) % 3], p = tri[3*t + (k+2) % 3];
+    int q = tri[3*s + (l+2) % 3];
+
+    /* The new triangles (p, u, q) and (q, v, p) must be CCW */
+    if (orient2d(x[p], y[p], x[u], y[u], x[q], y[q]) <= 0.0 ||
+        orient2d(x[q], y[q], x[v], y[v], x[p], y[p]) <= 0.0)
+        return 0;
+
+    if (method == FLIP_DELAUNAY) {
+        /* In-circle test of q against (u, v, p) */
+        double adx = x[u] - x[q], ady = y[u] - y[q];
+        double bdx = x[v] - x[q], bdy = y[v] - y[q];
+        double cdx = x[p] - x[q], cdy = y[p] - y[q];
+        double bc = bdx * cdy - cdx * bdy, ca = cdx * ady - adx * cdy, ab = adx * bdy - bdx * ady;
+        double al = adx * adx + ady * ady, bl = bdx * bdx + bdy * bdy, cl = cdx * cdx + cdy * cdy;
+        double det = al * bc + bl * ca + cl * ab;
+        double perm = al * fabs(bc) + bl * fabs(ca) + cl * fabs(ab);
+        return det > ICC_ERRBOUND * perm;
+    }
+
+    double before = fmin(min_angle_sin(x, y, u, v, p), min_angle_sin(x, y, v, u, q));
+    double after = fmin(min_angle_sin(x, y, p, u, q), min_angle_sin(x, y, q, v, p));
+    return after > before * (1.0 + 1e-9);
+}
+
+/*-------------------------------------------------------------
+  Helper: flip the edge e = (t, k), keeping the triangle ids;
+  t becomes (p, u, q) and its twin s becomes (q, v, p), with
+  their new diagonal as edge 2
+-------------------------------------------------------------*/
+static void flip_edge(int *tri, int *nbr, int e) {
+    int f = nbr[e];
+    int t = e / 3, k = e % 3, s = f / 3, l = f % 3;
+    int u = tri[3*t+k], v = tri[3*t + (k+1) % 3], p = tri[3*t + (k+2) % 3];
+    int q = tri[3*s + (l+2) % 3];
+    int e_vp = nbr[3*t + (k+1) % 3], e_pu = nbr[3*t + (k+2) % 3];
+    int e_uq = nbr[3*s + (l+1) % 3], e_qv = nbr[3*s + (l+2) % 3];
+
+    tri[3*t] = p; tri[3*t+1] = u; tri[3*t+2] = q;
+    tri[3*s] = q; tri[3*s+1] = v; tri[3*s+2] = p;
+    nbr[3*t] = e_pu; nbr[3*t+1] = e_uq; nbr[3*t+2] = 3*s + 2;
+    nbr[3*s] = e_qv; nbr[3*s+1] = e_vp; nbr[3*s+2] = 3*t + 2;
+    if (e_pu >= 0) nbr[e_pu] = 3*t;
+    if (e_uq >= 0) nbr[e_uq] = 3*t + 1;
+    if (e_qv >= 0) nbr[e_qv] = 3*s;
+    if (e_vp >= 0) nbr[e_vp] = 3*s + 1;
+}
+
+/*-------------------------------------------------------------
+  Helper: do the triangles of the quad of e and their outer
+  neighbours all lie in the triangle range [t0, t1)?
+-------------------------------------------------------------*/
+static int quad_inside(const int *nbr, int e, int t0, int t1) {
+    int f = nbr[e];
+    int h[2] = { e / 3, f / 3 };
+    for (int a = 0; a < 2; a++) {
+        if (h[a] < t0 || h[a] >= t1) return 0;
+        for (int k = 0; k < 3; k++) {
+            int g = nbr[3 * h[a] + k];
+            if (g >= 0 && (g / 3 < t0 || g / 3 >= t1)) return 0;
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Helper: work queue over the half-edges of the triangles
+  [t0, t1), a ring of 3 (t1 - t0) entries with one in-queue flag
+  per half-edge, seeded with one half of every interior edge,
+  or with the nseed half-edges already in the ring. With lim
+  set, quads reaching outside the range are left in *defer for
+  the sequential pass.
+  Returns the number of flips.
+-------------------------------------------------------------*/
+static int flip_range(const double *x, const double *y, int *tri, int *nbr,
+                      int t0, int t1, int method, int lim,
+                      int *ring, unsigned char *inq, unsigned char *defer, int nseed) {
+    int cap = 3 * (t1 - t0), head = 0, tail = 0, cnt = 0, flips = 0;
+#define PUSH(e) do { int e_ = (e); if (!inq[e_]) { inq[e_] = 1; ring[tail] = e_; \
+                     tail = tail + 1 == cap ? 0 : tail + 1; cnt++; } } while (0)
+    if (nseed < 0) {
+        for (int e = 3 * t0; e < 3 * t1; e++)
+            if (nbr[e] > e) PUSH(e);
+    } else {
+        for (int c = 0; c < nseed; c++) inq[ring[c]] = 1;
+        tail = cnt = nseed;
+    }
+    while (cnt > 0) {
+        int e = ring[head];
+        head = head + 1 == cap ? 0 : head + 1;
+        cnt--;
+        inq[e] = 0;
+        if (nbr[e] < 0) continue;
+        if (lim && !quad_inside(nbr, e, t0, t1)) { defer[e] = 1; continue; }
+        if (!want_flip(x, y, tri, nbr, e, method)) continue;
+        flip_edge(tri, nbr, e);
+        flips++;
+        int t = e / 3, s = nbr[3 * t + 2] / 3;
+        PUSH(3 * t);
+        PUSH(3 * t + 1);
+        PUSH(3 * s);
+        PUSH(3 * s + 1);
+    }
+#undef PUSH
+    return flips;
+}
+
+/*-------------------------------------------------------------
+  Improve a triangulation by edge flips
+  -------------------------------------------------------------
+  tri is changed in place (same number of triangles, same
+  vertices and boundary). hist0 and hist1, if not NULL, receive
+  the smallest-angle histograms before and after.
+  Returns the number of flips, or -1 if out of memory.
+-------------------------------------------------------------*/
+int improve_quality(
+    Grid2DWork *w,
+    double *x, double *y,            // Vertices
+    int *tri, int nt,                // Triangles, changed in place
+    int method,                      // FLIP_DELAUNAY or FLIP_MIN_ANGLE
+    int *hist0, int *hist1           // Output: histograms, or NULL
+) {
+    grid2d_work_reset(w);
+    if (hist0) quality_histogram(x, y, tri, nt, hist0);
+    if (nt < 2) {
+        if (hist1) quality_histogram(x, y, tri, nt, hist1);
+        return 0;
+    }
+
+    int nv = 0;
+    for (size_t q = 0; q < 3 * (size_t)nt; q++) if (tri[q] >= nv) nv = tri[q] + 1;
+    int *nbr = grid2d_work_alloc(w, 3 * (size_t)nt * sizeof(int));
+    int *ring = grid2d_work_alloc(w, 3 * (size_t)nt * sizeof(int));
+    unsigned char *inq = grid2d_work_alloc(w, 3 * (size_t)nt);
+    unsigned char *defer = grid2d_work_alloc(w, 3 * (size_t)nt);
+    if (!nbr || !ring || !inq || !defer || !triangle_adjacency(w, tri, nt, nv, nbr)) return -1;
+    memset(inq, 0, 3 * (size_t)nt);
+    memset(defer, 0, 3 * (size_t)nt);
+
+    /* ---- Chunks in parallel, each inside its own triangles ---- */
+    int nchunk = (nt + QUALITY_CHUNK - 1) / QUALITY_CHUNK, flips = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:flips)
+    for (int c = 0; c < nchunk; c++) {
+        int t0 = c * QUALITY_CHUNK, t1 = t0 + QUALITY_CHUNK < nt ? t0 + QUALITY_CHUNK : nt;
+        flips += flip_range(x, y, tri, nbr, t0, t1, method, nchunk > 1,
+                            ring + 3 * (size_t)t0, inq, defer, -1);
+    }
+
+    /* ---- Seams: the deferred edges, over the whole mesh ---- */
+    if (nchunk > 1) {
+        int nd = 0;
+        for (int e = 0; e < 3 * nt; e++) if (defer[e]) ring[nd++] = e;
+        if (nd > 0) flips += flip_range(x, y, tri, nbr, 0, nt, method, 0, ring, inq, defer, nd);
+    }
+
+    if (hist1) quality_histogram(x, y, tri, nt, hist1);
+    return flips;
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the edge-flip quality pass
+  Inputs (D*):
+    x, y   : double arrays with the vertex coordinates
+    tri    : integer array with the triangles, 3 indices each
+    method : integer, 0 for Delaunay flips (FLIP_DELAUNAY), 1
+             for smallest-angle flips (FLIP_MIN_ANGLE)
+  Returns: D list with the improved tri (the input array,
+  changed in place), the smallest-angle histograms before and
+  after (QUALITY_BINS counts each) and the number of flips, or
+  DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_improve_quality4(D *x, D *y, D *tri, D *method) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        tri->t != D_TIPO_INT || method->t != D_TIPO_INT) {
+        DError("improve_quality : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    if (x->n != y->n || tri->n % 3 != 0 || method->n != 1 ||
+        (method->p.i[0] != FLIP_DELAUNAY && method->p.i[0] != FLIP_MIN_ANGLE)) {
+        DError("improve_quality : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(tri);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check the vertex indices
+    for (int q = 0; q < tri->n; q++) {
+        if (tri->p.i[q] < 0 || tri->p.i[q] >= x->n) {
+            DError("improve_quality : vertex index out of range");
+            DLibera(x);
+            DLibera(y);
+            DLibera(tri);
+            DLibera(method);
+            return DCreaNulo();
+        }
+    }
+
+    D *h0 = DCreaInt(QUALITY_BINS);
+    D *h1 = DCreaInt(QUALITY_BINS);
+    int flips = improve_quality(grid2d_d_work(), x->p.d, y->p.d, tri->p.i, tri->n / 3,
+                                method->p.i[0], h0->p.i, h1->p.i);
+
+    D *output;
+    if (flips >= 0) {
+        D *df = DCreaInt(1);
+        df->p.i[0] = flips;
+        output = DCreaLista();
+        DInserta(output, tri);
+        DInserta(output, h0);
+        DInserta(output, h1);
+        DInserta(output, df);
+    } else {
+        DLibera(tri);
+        DLibera(h0);
+        DLibera(h1);
+        output = DCreaNulo();
+    }
+
+    DLibera(x);
+    DLibera(y);
+    DLibera(method);
+    return output;
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef GRID2D_NO_D
+#include "D.h"
+#endif
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Vertex and element renumbering
+  -------------------------------------------------------------
+  The meshers number the vertices in front order: base curve,
+  then offset, layer after layer. Two vertices of one element can
+  then be a whole curve apart, so the matrix of an FEM assembly on
+  the mesh has a bandwidth of the order of the curve length, and
+  every sweep over the elements jumps around in memory. This
+  stage renumbers a finished mesh:
+
+  - REORDER_RCM: reverse Cuthill-McKee. Breadth-first search over
+    the vertex graph (two vertices are adjacent when they share an
+    element), from a pseudo-peripheral vertex of each connected
+    component, visiting the neighbours by increasing degree; the
+    order found is reversed. It minimizes the bandwidth of the
+    matrix and gives a banded profile to direct solvers.
+  - REORDER_HILBERT: sort of the vertices along a Hilbert curve
+    over the bounding box (16 bits per axis). It only looks at the
+    coordinates, costs one radix sort, and keeps close vertices
+    close in memory in every direction.
+
+  The elements are then sorted, stably, by their lowest new
+  vertex, so that a sweep over the elements walks the vertices
+  almost in order.
+
+  Permutations map old numbers to new ones: vertex v becomes
+  vperm[v] and element e becomes eperm[e], so that any other
+  per-vertex or per-element array is moved with
+  a_new[vperm[v]] = a[v]. The elements have k vertices each
+  (3 for triangles, 4 for the quads of build_quad_band).
+
+  The scratch arrays are taken from the arena of a workspace
+  (see workspace.c). Every routine returns -1 if it runs out of
+  memory.
+-------------------------------------------------------------*/
+
+#define PERIPHERAL_ITER 8    // BFS sweeps in the pseudo-peripheral search
+
+/*-------------------------------------------------------------
+  Bandwidth of a mesh: the largest difference between two
+  vertices of one element (the half bandwidth of its matrix)
+-------------------------------------------------------------*/
+int mesh_bandwidth(int k, int ne, const int *el) {
+    int bw = 0;
+    for (int e = 0; e < ne; e++) {
+        const int *v = el + (size_t)k * e;
+        int lo = v[0], hi = v[0];
+        for (int j = 1; j < k; j++) {
+            if (v[j] < lo) lo = v[j];
+            if (v[j] > hi) hi = v[j];
+        }
+        if (hi - lo > bw) bw = hi - lo;
+    }
+    return bw;
+}
+
+/*-------------------------------------------------------------
+  Helper: vertex graph in CSR form, without repeated neighbours
+  (start[v] .. start[v+1]-1 in adj). Returns 0 if out of memory.
+-------------------------------------------------------------*/
+static int vertex_graph(Grid2DWork *w, int nv, int k, int ne, const int *el,
+                        int **start_, int **adj_) {
+    int *start = grid2d_work_alloc(w, (nv + 1) * sizeof(int));
+    int *adj = grid2d_work_alloc(w, (size_t)ne * k * (k - 1) * sizeof(int));
+    int *seen = grid2d_work_alloc(w, nv * sizeof(int));
+    if (!start || !adj || !seen) return 0;
+
+    /* ---- Count, then store every pair of each element ---- */
+    memset(start, 0, (nv + 1) * sizeof(int));
+    for (size_t q = 0; q < (size_t)ne * k; q++) start[el[q] + 1] += k - 1;
+    for (int v = 0; v < nv; v++) start[v+1] += start[v];
+    for (int e = 0; e < ne; e++) {
+        const int *v = el + (size_t)k * e;
+        for (int a = 0; a < k; a++)
+            for (int b = 0; b < k; b++)
+                if (a != b) adj[start[v[a]]++] = v[b];
+    }
+    for (int v = nv; v > 0; v--) start[v] = start[v-1];
+    start[0] = 0;
+
+    /* ---- Drop the repeated neighbours, compacting in place ---- */
+    for (int v = 0; v < nv; v++) seen[v] = -1;
+    int top = 0;
+    for (int v = 0; v < nv; v++) {
+        int s0 = start[v], s1 = start[v+1];
+        start[v] = top;
+        for (int q = s0; q < s1; q++) {
+            int u = adj[q];
+            if (seen[u] == v || u == v) continue;
+            seen[u] = v;
+            adj[top++] = u;
+        }
+    }
+    start[nv] = top;
+
+    *start_ = start;
+    *adj_ = adj;
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Helper: breadth-first levels from root, appended to queue
+  from position q0; marks the vertices with stamp. Returns the
+  number of levels, and *last the position of the last level.
+-------------------------------------------------------------*/
+static int bfs_levels(const int *start, const int *adj, int root, int stamp,
+                      int *mark, int *queue, int q0, int *qend, int *last) {
+    int head = q0, tail = q0, levels = 0;
+    queue[tail++] = root;
+    mark[root] = stamp;
+    while (head < tail) {
+        int lend = tail;
+        *last = head;
+        levels++;
+        for (; head < lend; head++) {
+            int u = queue[head];
+            for (int q = start[u]; q < start[u+1]; q++) {
+                int v = adj[q];
+                if (mark[v] != stamp) { mark[v] = stamp; queue[tail++] = v; }
+            }
+        }
+    }
+    *qend = tail;
+    return levels;
+}
+
+/*-------------------------------------------------------------
+  Reverse Cuthill-McKee vertex order: vperm[v] = new number of v
+  Returns the bandwidth of the renumbered mesh.
+-------------------------------------------------------------*/
+int reorder_rcm(Grid2DWork *w, int nv, int k, int ne, const int *el, int *vperm) {
+    int *start, *adj;
+    if (!vertex_graph(w, nv, k, ne, el, &start, &adj)) return -1;
+    int *mark = grid2d_work_alloc(w, nv * sizeof(int));
+    int *order = grid2d_work_alloc(w, nv * sizeof(int));
+    if (!mark || !order) return -1;
+    for (int v = 0; v < nv; v++) mark[v] = -1;
+
+#define DEG(v) (start[(v)+1] - start[(v)])
+
+    int stamp = 0, no = 0;
+    for (int v0 = 0; v0 < nv; v0++) {
+        if (mark[v0] == 0) continue;    // already numbered
+
+        /* ---- Pseudo-peripheral root of the component of v0
+           (George and Liu): restart from the lowest degree vertex
+           of the last level while the depth grows. The sweeps run
+           in the unused tail of order. ---- */
+        int root = v0, qend, last;
+        int depth = bfs_levels(start, adj, root, ++stamp, mark, order, no, &qend, &last);
+        for (int it = 0; it < PERIPHERAL_ITER; it++) {
+            int best = order[last];
+            for (int q = last + 1; q < qend; q++)
+                if (DEG(order[q]) < DEG(best)) best = order[q];
+            int d = bfs_levels(start, adj, best, ++stamp, mark, order, no, &qend, &last);
+            if (d <= depth) break;
+            depth = d;
+            root = best;
+        }
+
+        /* ---- Cuthill-McKee from root; mark 0 means numbered ---- */
+        int head = no;
+        order[no++] = root;
+        mark[root] = 0;
+        while (head < no) {
+            int u = order[head++], first = no;
+            for (int q = start[u]; q < start[u+1]; q++) {
+                int v = adj[q];
+                if (mark[v] != 0) { mark[v] = 0; order[no++] = v; }
+            }
+            /* Neighbours by increasing degree (short lists) */
+            for (int a = first + 1; a < no; a++) {
+                int v = order[a], b = a;
+                while (b > first && DEG(order[b-1]) > DEG(v)) { order[b] = order[b-1]; b--; }
+                order[b] = v;
+            }
+        }
+    }
+#undef DEG
+
+    for (int i = 0; i < nv; i++) vperm[order[i]] = nv - 1 - i;
+
+    int bw = 0;
+    for (int v = 0; v < nv; v++)
+        for (int q = start[v]; q < start[v+1]; q++) {
+            int d = vperm[v] - vperm[adj[q]];
+            if (d > bw) bw = d;
+        }
+    return bw;
+}
+
+/*-------------------------------------------------------------
+  Helper: spread the 16 low bits of x to the even bits
+-------------------------------------------------------------*/
+static inline uint32_t spread_bits(uint32_t x) {
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+/*-------------------------------------------------------------
+  Helper: position of the cell (x, y) along the Hilbert curve
+  of a 2^16 x 2^16 grid
+  The rotations of the quadrants, which the textbook loop does
+  one level at a time with branches, are composed with a prefix
+  scan over the bits (four rounds of shifts and logic), so that
+  a key costs a few dozen branch-free operations.
+-------------------------------------------------------------*/
+static inline uint32_t hilbert_key(uint32_t x, uint32_t y) {
+    uint32_t A, B, C, D;
+    {
+        uint32_t a = x ^ y;
+        uint32_t b = 0xffff ^ a;
+        uint32_t c = 0xffff ^ (x | y);
+        uint32_t d = x & (y ^ 0xffff);
+        A = a | (b >> 1);
+        B = (a >> 1) ^ a;
+        C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+        D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+    }
+    for (int sh = 2; sh <= 4; sh *= 2) {
+        uint32_t a = A, b = B, c = C, d = D;
+        A = (a & (a >> sh)) ^ (b & (b >> sh));
+        B = (a & (b >> sh)) ^ (b & ((a ^ b) >> sh));
+        C ^= (a & (c >> sh)) ^ (b & (d >> sh));
+        D ^= (b & (c >> sh)) ^ ((a ^ b) & (d >> sh));
+    }
+    {
+        uint32_t a = A, b = B, c = C, d = D;
+        C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+        D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+    }
+    uint32_t a = C ^ (C >> 1), b = D ^ (D >> 1);
+    uint32_t i0 = x ^ y;
+    uint32_t i1 = b | (0xffff ^ (i0 | a));
+    return (spread_bits(i1) << 1) | spread_bits(i0);
+}
+
+/*-------------------------------------------------------------
+  Hilbert curve vertex order: vperm[v] = new number of v
+  Returns 0, or -1 if out of memory.
+-------------------------------------------------------------*/
+int reorder_hilbert(Grid2DWork *w, int nv, const double *x, const double *y, int *vperm) {
+    if (nv < 1) return 0;
+    uint32_t *key = grid2d_work_alloc(w, 2 * (size_t)nv * sizeof(uint32_t));
+    int *id = grid2d_work_alloc(w, 2 * (size_t)nv * sizeof(int));
+    if (!key || !id) return -1;
+
+    double xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0];
+    for (int v = 1; v < nv; v++) {
+        if (x[v] < xmin) xmin = x[v];
+        if (x[v] > xmax) xmax = x[v];
+        if (y[v] < ymin) ymin = y[v];
+        if (y[v] > ymax) ymax = y[v];
+    }
+    /* Same scale on both axes, so that the cells are square */
+    double ext = xmax - xmin > ymax - ymin ? xmax - xmin : ymax - ymin;
+    double sc = ext > 0.0 ? 65535.0 / ext : 0.0;
+    for (int v = 0; v < nv; v++) {
+        key[v] = hilbert_key((uint32_t)((x[v] - xmin) * sc), (uint32_t)((y[v] - ymin) * sc));
+        id[v] = v;
+    }
+
+    /* ---- LSD radix sort, 8 bits per pass, stable ---- */
+    uint32_t *ka = key, *kb = key + nv;
+    int *ia = id, *ib = id + nv;
+    for (int sh = 0; sh < 32; sh += 8) {
+        int cnt[257] = { 0 };
+        for (int v = 0; v < nv; v++) cnt[((ka[v] >> sh) & 0xff) + 1]++;
+        for (int b = 0; b < 256; b++) cnt[b+1] += cnt[b];
+        for (int v = 0; v < nv; v++) {
+            int p = cnt[(ka[v] >> sh) & 0xff]++;
+            kb[p] = ka[v];
+            ib[p] = ia[v];
+        }
+        uint32_t *kt = ka; ka = kb; kb = kt;
+        int *it = ia; ia = ib; ib = it;
+    }
+
+    for (int i = 0; i < nv; i++) vperm[ia[i]] = i;
+    return 0;
+}
+
+/*-------------------------------------------------------------
+  Renumber a mesh in place
+  -------------------------------------------------------------
+  Computes the vertex order with the given method, moves the
+  coordinates and renumbers the elements, then sorts the
+  elements by their lowest vertex. vperm (nv entries) and eperm
+  (ne entries) receive the permutations, old to new.
+  Returns the new bandwidth, or -1 for an unknown method or out
+  of memory (the mesh is then unchanged).
+-------------------------------------------------------------*/
+int reorder_mesh(
+    Grid2DWork *w, int method,
+    double *x, double *y, int nv,    // Vertices
+    int k, int *el, int ne,          // Elements, k vertices each
+    int *vperm, int *eperm           // Output: permutations
+) {
+    grid2d_work_reset(w);
+    int r;
+    if (method == REORDER_RCM) r = reorder_rcm(w, nv, k, ne, el, vperm);
+    else if (method == REORDER_HILBERT) r = reorder_hilbert(w, nv, x, y, vperm);
+    else return -1;
+    if (r < 0) return -1;
+
+    double *t = grid2d_work_alloc(w, nv * sizeof(double));
+    int *cnt = grid2d_work_alloc(w, (nv + 1) * sizeof(int));
+    int *te = grid2d_work_alloc(w, (size_t)ne * k * sizeof(int));
+    if (!t || !cnt || !te) return -1;
+
+    /* ---- Coordinates ---- */
+    for (int v = 0; v < nv; v++) t[vperm[v]] = x[v];
+    memcpy(x, t, nv * sizeof(double));
+    for (int v = 0; v < nv; v++) t[vperm[v]] = y[v];
+    memcpy(y, t, nv * sizeof(double));
+
+    /* ---- Elements: renumber, then counting sort by lowest vertex ---- */
+    memset(cnt, 0, (nv + 1) * sizeof(int));
+    for (int e = 0; e < ne; e++) {
+        int *v = el + (size_t)k * e, lo = nv;
+        for (int j = 0; j < k; j++) {
+            v[j] = vperm[v[j]];
+            if (v[j] < lo) lo = v[j];
+        }
+        cnt[lo + 1]++;
+    }
+    for (int v = 0; v < nv; v++) cnt[v+1] += cnt[v];
+    for (int e = 0; e < ne; e++) {
+        int *v = el + (size_t)k * e, lo = v[0];
+        for (int j = 1; j < k; j++) if (v[j] < lo) lo = v[j];
+        eperm[e] = cnt[lo]++;
+        memcpy(te + (size_t)k * eperm[e], v, k * sizeof(int));
+    }
+    memcpy(el, te, (size_t)ne * k * sizeof(int));
+
+    return mesh_bandwidth(k, ne, el);
+}
+
+#ifndef GRID2D_NO_D
+
+/*-------------------------------------------------------------
+  Wrapper for the mesh renumbering
+  Inputs (D*):
+    x, y   : double arrays with the vertex coordinates
+    el     : integer array with the elements, k indices each
+    k      : integer, vertices per element (3 or 4)
+    method : integer, 0 for reverse Cuthill-McKee
+             (REORDER_RCM), 1 for the Hilbert curve sort
+             (REORDER_HILBERT)
+  Returns: D list with the renumbered x, y and el (the input
+  arrays, changed in place), the permutations vperm and eperm
+  (old to new) and the new bandwidth, or DCreaNulo() on error
+-------------------------------------------------------------*/
+D *_reorder5(D *x, D *y, D *el, D *k, D *method) {
+    // Check if there were errors in upper levels
+    if (!DRun) {
+        DLibera(x);
+        DLibera(y);
+        DLibera(el);
+        DLibera(k);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if (x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE ||
+        el->t != D_TIPO_INT || k->t != D_TIPO_INT || method->t != D_TIPO_INT) {
+        DError("reorder : bad argument type");
+        DLibera(x);
+        DLibera(y);
+        DLibera(el);
+        DLibera(k);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check sizes of arguments
+    int kv = k->n == 1 ? k->p.i[0] : 0;
+    if (x->n != y->n || (kv != 3 && kv != 4) || el->n % kv != 0 ||
+        method->n != 1 ||
+        (method->p.i[0] != REORDER_RCM && method->p.i[0] != REORDER_HILBERT)) {
+        DError("reorder : bad argument size");
+        DLibera(x);
+        DLibera(y);
+        DLibera(el);
+        DLibera(k);
+        DLibera(method);
+        return DCreaNulo();
+    }
+
+    // Check the vertex indices
+    int nv = x->n, ne = el->n / kv;
+    for (int q = 0; q < el->n; q++) {
+        if (el->p.i[q] < 0 || el->p.i[q] >= nv) {
+            DError("reorder : vertex index out of range");
+            DLibera(x);
+            DLibera(y);
+            DLibera(el);
+            DLibera(k);
+            DLibera(method);
+            return DCreaNulo();
+        }
+    }
+
+    D *vperm = DCreaInt(nv);
+    D *eperm = DCreaInt(ne);
+    int bw = reorder_mesh(grid2d_d_work(), method->p.i[0], x->p.d, y->p.d, nv,
+                          kv, el->p.i, ne, vperm->p.i, eperm->p.i);
+
+    D *output;
+    if (bw >= 0) {
+        D *dbw = DCreaInt(1);
+        dbw->p.i[0] = bw;
+        output = DCreaLista();
+        DInserta(output, x);
+        DInserta(output, y);
+        DInserta(output, el);
+        DInserta(output, vperm);
+        DInserta(output, eperm);
+        DInserta(output, dbw);
+    } else {
+        DLibera(x);
+        DLibera(y);
+        DLibera(el);
+        DLibera(vperm);
+        DLibera(eperm);
+        output = DCreaNulo();
+    }
+
+    DLibera(k);
+    DLibera(method);
+    return output;
+}
+
+#endif
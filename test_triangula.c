@@ -1,10 +1,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "predicates.h"
 
 //-------------------- Función área 2D --------------------
+// Signo exacto aunque los puntos estén casi alineados (predicates.h)
 double area2D(double x0,double y0,double x1,double y1,double x2,double y2){
-    return (x1-x0)*(y2-y0) - (y1-y0)*(x2-x0);
+    return orient2d(x0,y0,x1,y1,x2,y2);
 }
 
 
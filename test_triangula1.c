@@ -27,80 +27,81 @@ void procesa_triangulo(int i0, int i1, double ax, double ay)
 }
 
 /*------------------------------------------------------------
-   Genera una curva paralela a la derecha.
-   La curva está definida por índices (1-based) sobre arrays globales x[], y[].
+   Versión reentrante con contexto
+   Las rutinas de procesamiento se pasan en una tabla
+   OffsetCallbacks (offset_engine.h) y reciben un puntero de
+   contexto del usuario, así que no hacen falta variables globales
+   y se pueden lanzar varias curvas a la vez en distintos hilos.
 ------------------------------------------------------------*/
-void offset_curve(double *x, double *y, int *ind, int n, double h)
+
+/*------------------------------------------------------------
+   Cuerpo común: el motor de desplazamiento con entrada por
+   índices (1-based) sobre arrays x[], y[] y salida por rutinas.
+   Se expande siempre en línea: si la tabla cb es constante en
+   compilación, las llamadas indirectas se convierten en llamadas
+   directas (o desaparecen si las rutinas son inline).
+------------------------------------------------------------*/
+#define OE_NAME offset_motor
+#define OE_INPUT OE_INDEX1
+#define OE_SINK OE_CALLBACK
+#define OE_FILTER 0
+#include "offset_engine.h"
+
+/* curva paralela a la derecha: -h en el motor */
+#define offset_curve_cuerpo(x, y, ind, n, h, cb, ctx) \
+    ((void)offset_motor(x, y, ind, n, -(h), cb, ctx))
+
+/*------------------------------------------------------------
+   Versión con tabla de rutinas en tiempo de ejecución
+------------------------------------------------------------*/
+void offset_curve_ctx(double *x, double *y, int *ind, int n, double h,
+                      const OffsetCallbacks *cb, void *ctx)
 {
-    int i;
-    double dx1, dy1, dx2, dy2, nx, ny, len;
-    double ax, ay, bx, by;
-
-    if (n < 2) return;
-
-    /* --- primer punto desplazado --- */
-    int i0 = ind[0] - 1;
-    int i1 = ind[1] - 1;
-    dx1 = x[i1] - x[i0];
-    dy1 = y[i1] - y[i0];
-    len = sqrt(dx1*dx1 + dy1*dy1);
-    if (len == 0) return;
-    nx =  dy1 / len;
-    ny = -dx1 / len;
-    ax = x[i0] + h * nx;
-    ay = y[i0] + h * ny;
-    procesa_punto(ax, ay);
+    offset_curve_cuerpo(x, y, ind, n, h, cb, ctx);
+}
 
-    /* --- procesamos tramo a tramo --- */
-    for (i = 0; i < n - 1; i++) {
-        i0 = ind[i] - 1;
-        i1 = ind[i+1] - 1;
-
-        dx1 = x[i1] - x[i0];
-        dy1 = y[i1] - y[i0];
-        len = sqrt(dx1*dx1 + dy1*dy1);
-        if (len == 0) continue;
-
-        /* bisectriz si hay un siguiente tramo */
-        if (i < n - 2) {
-            int i2 = ind[i+2] - 1;
-            dx2 = x[i2] - x[i1];
-            dy2 = y[i2] - y[i1];
-            double len1 = sqrt(dx1*dx1 + dy1*dy1);
-            double len2 = sqrt(dx2*dx2 + dy2*dy2);
-            nx = (dy1/len1 + dy2/len2) * 0.5;
-            ny = (-dx1/len1 - dx2/len2) * 0.5;
-            len = sqrt(nx*nx + ny*ny);
-            if (len != 0) { nx /= len; ny /= len; }
-        } else {
-            nx =  dy1 / len;
-            ny = -dx1 / len;
-        }
-
-        bx = x[i1] + h * nx;
-        by = y[i1] + h * ny;
-
-        /* comprobar intersección de (P_i,B) y (P_{i+1},A) */
-        double x1 = x[i0], y1 = y[i0];
-        double x2 = bx,    y2 = by;
-        double x3 = x[i1], y3 = y[i1];
-        double x4 = ax,    y4 = ay;
-
-        double den = (x1-x2)*(y3-y4) - (y1-y2)*(x3-x4);
-        int intersect = 0;
-        if (fabs(den) > 1e-12) {
-            double t = ((x1-x3)*(y3-y4) - (y1-y3)*(x3-x4)) / den;
-            double u = ((x1-x3)*(y1-y2) - (y1-y3)*(x1-x2)) / den;
-            if (t >= 0 && t <= 1 && u >= 0 && u <= 1) intersect = 1;
-        }
-
-        if (!intersect) {
-            int r = procesa_cuadrilatero(i0, i1, ax, ay, bx, by);
-            if (r) { ax = bx; ay = by; }
-        } else {
-            procesa_triangulo(i0, i1, ax, ay);
-        }
+/*------------------------------------------------------------
+   Versión con las rutinas fijadas en compilación
+   OFFSET_CURVE_POLITICA(nombre, punto, cuadrilatero, triangulo)
+   define una función static
+      nombre(x, y, ind, n, h, ctx)
+   en la que las tres rutinas se llaman directamente.
+------------------------------------------------------------*/
+#define OFFSET_CURVE_POLITICA(nombre, punto, cuadrilatero, triangulo)      \
+    static void nombre(double *x, double *y, int *ind, int n, double h,   \
+                       void *ctx)                                        \
+    {                                                                    \
+        static const OffsetCallbacks cb_ = { punto, cuadrilatero, triangulo }; \
+        offset_curve_cuerpo(x, y, ind, n, h, &cb_, ctx);                 \
     }
+
+/*------------------------------------------------------------
+   Versión original, con las rutinas procesa_* globales
+------------------------------------------------------------*/
+static inline void global_punto(void *ctx, double ax, double ay)
+{
+    (void)ctx;
+    procesa_punto(ax, ay);
+}
+
+static inline int global_cuadrilatero(void *ctx, int i0, int i1,
+                                      double ax, double ay, double bx, double by)
+{
+    (void)ctx;
+    return procesa_cuadrilatero(i0, i1, ax, ay, bx, by);
+}
+
+static inline void global_triangulo(void *ctx, int i0, int i1, double ax, double ay)
+{
+    (void)ctx;
+    procesa_triangulo(i0, i1, ax, ay);
+}
+
+OFFSET_CURVE_POLITICA(offset_curve_global, global_punto, global_cuadrilatero, global_triangulo)
+
+void offset_curve(double *x, double *y, int *ind, int n, double h)
+{
+    offset_curve_global(x, y, ind, n, h, NULL);
 }
 
 /*------------------------------------------------------------
@@ -1,17 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "fill_engine.h"
 
 /* ===========================================================
    Helper functions
    =========================================================== */
 
-// Compute oriented area (twice the triangle area, signed)
-// Positive if counterclockwise (CCW)
-static double area(double xa, double ya, double xb, double yb, double xc, double yc)
-{
-    return (xb - xa) * (yc - ya) - (yb - ya) * (xc - xa);
-}
-
 // Squared distance between two points (no sqrt needed)
 static double dist2(double xa, double ya, double xb, double yb)
 {
@@ -23,6 +19,36 @@ static double dist2(double xa, double ya, double xb, double yb)
    Main triangulation routine
    =========================================================== */
 
+/* Zipper instances (fill_engine.h) */
+#define FE_NAME fill_zip
+#define FE_REPAIR 0
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_repair
+#define FE_REPAIR 1
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_stream
+#define FE_SINK FE_STREAM
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_range
+#define FE_INPUT FE_RANGE
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_f
+#define FE_FLOAT 1
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_adj
+#define FE_ADJ 1
+#include "fill_engine.h"
+
+#define FE_NAME fill_zip_range_f
+#define FE_INPUT FE_RANGE
+#define FE_FLOAT 1
+#include "fill_engine.h"
+
 /*
  * Fill the space between two polygonal curves with triangles.
  * The triangles are oriented CCW (counterclockwise).
@@ -36,7 +62,9 @@ static double dist2(double xa, double ya, double xb, double yb)
  *   tri   : integer array [3*(na+nb-2)] with vertex indices
  *
  * Return:
- *   Number of triangles generated (should be na + nb - 2)
+ *   Number of triangles generated (should be na + nb - 2),
+ *   or 0 if the zipper meets a spot where both candidate
+ *   triangles are inverted
  */
 int fill_between(
     double *x, double *y,
@@ -44,78 +72,508 @@ int fill_between(
     int *ib, int nb,
     int *tri)
 {
-    int i = 0, j = 0, nt = 0;
-    int sel;
-    double SABC, SABD, SADC, SCBD;
-    double DBC, DAC;
+    return fill_zip(x, y, ia, na, ib, nb, tri);
+}
 
-    while (i < na - 1 && j < nb - 1) {
-        int A = ia[i];
-        int B = ib[j];
-        int C = ia[i+1];
-        int D = ib[j+1];
+/*
+ * Same as fill_between, writing into the triangle buffer of a
+ * workspace, which grows only when needed (see workspace.c).
+ * *tri is set to the buffer.
+ */
+int fill_between_ws(
+    Grid2DWork *w,
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int **tri)
+{
+    if (na + nb < 3 || !grid2d_work_reserve_tri(w, na + nb - 2)) return 0;
+    *tri = w->tri;
+    return fill_zip(x, y, ia, na, ib, nb, w->tri);
+}
+
+/* ===========================================================
+   Window re-zip of the repair mode
+   =========================================================== */
 
-        // Compute oriented areas
-        SABC = area(x[A], y[A], x[B], y[B], x[C], y[C]);
-        SABD = area(x[A], y[A], x[B], y[B], x[D], y[D]);
+#define FILL_WINDOW 256     // largest window zipped again, in triangles
 
-        // If both areas are negative, return 0 (invalid configuration)
-        if (SABC < 0.0 && SABD < 0.0) {
+// Marks kept in side[k] next to the curve bit of the zipper
+#define FILL_REPAIRED 2     // triangle k emitted or changed by a repair
+#define FILL_INVERTED 4     // triangle k inverted at the end
+#define FILL_INNER 8        // rung k inside a window zipped again
+
+// Orientation of a triangle given by its 3 vertex indices
+static double tri_orient(const double *x, const double *y, const int *t)
+{
+    return orient2d(x[t[0]], y[t[0]], x[t[1]], y[t[1]], x[t[2]], y[t[2]]);
+}
+
+// Is u - v an edge of triangle t?
+static int tri_has_edge(const int *t, int u, int v)
+{
+    int hu = t[0] == u || t[1] == u || t[2] == u;
+    int hv = t[0] == v || t[1] == v || t[2] == v;
+    return hu && hv;
+}
+
+/*
+ * Helper: is corner v of the polygon p (linked by nx) an ear,
+ * a CCW triangle a, v, c with no other vertex of the polygon in
+ * it or on its sides? With strict = 0 a flat ear is accepted too.
+ */
+static int window_ear(const double *x, const double *y, const int *p, const int *nx,
+                      int a, int v, int c, int strict)
+{
+    int A = p[a], V = p[v], C = p[c];
+    double o = orient2d(x[A], y[A], x[V], y[V], x[C], y[C]);
+    if (o < 0.0 || (strict && o == 0.0)) return 0;
+    for (int r = nx[c]; r != a; r = nx[r]) {
+        int R = p[r];
+        if ((x[R] == x[A] && y[R] == y[A]) || (x[R] == x[V] && y[R] == y[V]) ||
+            (x[R] == x[C] && y[R] == y[C]))
+            continue;
+        if (orient2d(x[A], y[A], x[V], y[V], x[R], y[R]) >= 0.0 &&
+            orient2d(x[V], y[V], x[C], y[C], x[R], y[R]) >= 0.0 &&
+            orient2d(x[C], y[C], x[A], y[A], x[R], y[R]) >= 0.0)
             return 0;
-        }
+    }
+    return 1;
+}
 
-        if (SABC < 0.0) {
-            sel = 1;   // advance along ib
-        } else if (SABD < 0.0) {
-            sel = 0;   // advance along ia
+/*
+ * Helper: triangulate the CCW polygon p[0..np-1] by ear clipping
+ * into out[3*(np-2)]. Flat ears are only taken when no proper one
+ * is left.
+ * Returns 1, or 0 if the polygon is not simple (no ear left).
+ */
+static int window_clip(const double *x, const double *y, const int *p, int np, int *out)
+{
+    int nx[FILL_WINDOW + 2], pv[FILL_WINDOW + 2];
+    if (np < 3) return 0;
+    for (int k = 0; k < np; k++) {
+        nx[k] = k + 1 < np ? k + 1 : 0;
+        pv[k] = k > 0 ? k - 1 : np - 1;
+    }
+    int left = np, v = 0, miss = 0, strict = 1;
+    while (left > 3) {
+        int a = pv[v], c = nx[v];
+        if (window_ear(x, y, p, nx, a, v, c, strict)) {
+            *out++ = p[a];
+            *out++ = p[v];
+            *out++ = p[c];
+            nx[a] = c;
+            pv[c] = a;
+            left--;
+            v = a;
+            miss = 0;
+            strict = 1;
         } else {
-            // Both triangles OK, check next configurations
-            SCBD = area(x[C], y[C], x[B], y[B], x[D], y[D]);
-            SADC = area(x[A], y[A], x[D], y[D], x[C], y[C]);
-
-            if (SCBD < 0.0) sel = 0;
-            else if (SADC < 0.0) sel = 1;
-            else {
-                // Compare distances between BC and AD
-                DBC = dist2(x[B], y[B], x[C], y[C]);
-                DAC = dist2(x[A], y[A], x[D], y[D]);
-                sel = (DBC < DAC) ? 0 : 1;
+            v = c;
+            if (++miss > left) {
+                if (!strict) return 0;
+                strict = 0;
+                miss = 0;
             }
         }
+    }
+    out[0] = p[pv[v]];
+    out[1] = p[v];
+    out[2] = p[nx[v]];
+    return tri_orient(x, y, out) >= 0.0;
+}
 
-        // Build triangle and advance
-        if (sel == 0) { // advance along ia
-            tri[3*nt+0] = ia[i];
-            tri[3*nt+1] = ib[j];
-            tri[3*nt+2] = ia[i+1];
-            i++;
-        } else {        // advance along ib
-            tri[3*nt+0] = ia[i];
-            tri[3*nt+1] = ib[j];
-            tri[3*nt+2] = ib[j+1];
-            j++;
+/*
+ * Helper: zip again the window of triangles k0..k1, which spans
+ * ia[i0..i1] and ib[j0..j1]: the polygon ia[i1] .. ia[i0],
+ * ib[j0] .. ib[j1] (CCW, as the triangles of the zipper) is
+ * triangulated into the same number of triangles.
+ * Returns 1 if tri[3*k0 ..] was replaced by CCW triangles.
+ */
+static int window_zip(double *x, double *y, int *ia, int *ib,
+                      int i0, int i1, int j0, int j1, int *tri, int k0)
+{
+    int p[FILL_WINDOW + 2], np = 0, out[3 * FILL_WINDOW];
+    for (int i = i1; i >= i0; i--) p[np++] = ia[i];
+    for (int j = j0; j <= j1; j++) p[np++] = ib[j];
+    if (!window_clip(x, y, p, np, out)) return 0;
+    memcpy(tri + 3 * k0, out, 3 * (np - 2) * sizeof(int));
+    return 1;
+}
+
+/*
+ * Helper: is rung k, the edge ia[i] - ib[j] between triangles
+ * k-1 and k of the zipper, still a boundary between them? A flip
+ * across it removes it, and a window zipped again keeps only its
+ * end rungs.
+ */
+static int fill_rung(const int *tri, const unsigned char *side, int nt,
+                     int k, int u, int v)
+{
+    if (k == 0 || k == nt) return 1;
+    return !(side[k] & FILL_INNER) &&
+           tri_has_edge(tri + 3 * k, u, v) && tri_has_edge(tri + 3 * (k - 1), u, v);
+}
+
+/*
+ * Helper: window re-zip of the triangles the flips of the zipper
+ * left inverted. Around each one, windows of 5, 9, 17 ...
+ * triangles (at most FILL_WINDOW) are tried until one can be
+ * triangulated with CCW triangles only. A window ends on rungs
+ * still in place (see fill_rung), so it is stretched to the next
+ * ones, over the windows already zipped again if needed.
+ * side[k] holds the curve bit of the zipper and gets the marks
+ * FILL_REPAIRED and FILL_INNER.
+ */
+static void fill_rezip(double *x, double *y, int *ia, int *ib, int nt, int *tri,
+                       unsigned char *side, const int *rep, int nrep)
+{
+    for (int r = 0; r < nrep; r++) side[rep[r]] |= FILL_REPAIRED;
+
+    int k = 0, i = 0, j = 0;            // triangle k starts at ia[i], ib[j]
+    for (int r = 0; r < nrep; r++) {
+        int t = rep[r];
+        if (tri_orient(x, y, tri + 3 * t) >= 0.0) continue;
+        for (; k < t; k++) {
+            if (side[k] & 1) j++;
+            else i++;
+        }
+        int fixed = 0;
+        for (int h = 2; !fixed; h *= 2) {
+            int k0 = t - h > 0 ? t - h : 0, k1 = t + h < nt - 1 ? t + h : nt - 1;
+            int i0 = i, j0 = j, i1 = i, j1 = j;
+            for (int q = t - 1; q >= k0; q--) {
+                if (side[q] & 1) j0--;
+                else i0--;
+            }
+            for (int q = t; q <= k1; q++) {
+                if (side[q] & 1) j1++;
+                else i1++;
+            }
+            // Stretch the window to rungs still in place
+            while (!fill_rung(tri, side, nt, k0, ia[i0], ib[j0])) {
+                k0--;
+                if (side[k0] & 1) j0--;
+                else i0--;
+            }
+            while (!fill_rung(tri, side, nt, k1 + 1, ia[i1], ib[j1])) {
+                k1++;
+                if (side[k1] & 1) j1++;
+                else i1++;
+            }
+            if (k1 - k0 + 1 > FILL_WINDOW) break;
+            fixed = window_zip(x, y, ia, ib, i0, i1, j0, j1, tri, k0);
+            if (fixed) {
+                for (int q = k0; q <= k1; q++) side[q] |= FILL_REPAIRED;
+                for (int q = k0 + 1; q <= k1; q++) side[q] |= FILL_INNER;
+            }
+            if (k0 == 0 && k1 == nt - 1) break;
         }
-        nt++;
     }
+}
 
-    // Complete the remaining strip
-    while (i < na - 1) {
-        tri[3*nt+0] = ia[i];
-        tri[3*nt+1] = ib[nb-1];
-        tri[3*nt+2] = ia[i+1];
-        i++;
-        nt++;
+/*
+ * Same as fill_between, in repair mode.
+ *
+ * Instead of giving up at a spot where both candidate triangles
+ * are inverted, the zipper emits the least inverted one and
+ * flips its edge with the previous triangle when that makes both
+ * CCW, then goes on. A triangle no flip could fix is fixed by
+ * zipping again a window of the band around it: the polygon made
+ * of the stretches of the two curves it spans is triangulated by
+ * ear clipping, with windows of up to FILL_WINDOW triangles. One
+ * bad spot costs a local fix and the rest of the band is still
+ * produced.
+ *
+ * Output:
+ *   tri   : integer array [3*(na+nb-2)] with vertex indices
+ *   rep   : integer array [na+nb-2]; rep[0..nrep-1] receives the
+ *           indices of the triangles emitted or changed by a
+ *           repair, all CCW now, and rep[nrep..nrep+nbad-1]
+ *           those no repair could fix, still inverted
+ *   nrep  : number of repaired triangles
+ *   nbad  : number of triangles left inverted (0 when the band
+ *           is valid)
+ *
+ * Return:
+ *   Number of triangles generated (na + nb - 2), or 0 on failure
+ *   (out of memory). A band whose curves cross each other cannot
+ *   be zipped with CCW triangles: *nbad > 0 tells it apart from a
+ *   repaired band.
+ */
+int fill_between_repair(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int *rep, int *nrep, int *nbad)
+{
+    *nrep = *nbad = 0;
+    if (na < 1 || nb < 1 || na + nb < 3) return 0;
+    unsigned char *side = malloc(na + nb - 2);
+    if (!side) return 0;
+    int nt = fill_zip_repair(x, y, ia, na, ib, nb, tri, rep, nrep, side);
+    if (nt > 0 && *nrep > 0) {
+        fill_rezip(x, y, ia, ib, nt, tri, side, rep, *nrep);
+
+        // Repaired triangles first, then those left inverted
+        int n = 0;
+        for (int k = 0; k < nt; k++)
+            if (side[k] & FILL_REPAIRED) {
+                if (tri_orient(x, y, tri + 3 * k) < 0.0) side[k] |= FILL_INVERTED;
+                else rep[n++] = k;
+            }
+        *nrep = n;
+        for (int k = 0; k < nt; k++)
+            if (side[k] & FILL_INVERTED) rep[n++] = k;
+        *nbad = n - *nrep;
     }
-    while (j < nb - 1) {
-        tri[3*nt+0] = ia[na-1];
-        tri[3*nt+1] = ib[j];
-        tri[3*nt+2] = ib[j+1];
-        j++;
-        nt++;
+    free(side);
+    return nt;
+}
+
+/*
+ * Same as fill_between, streaming the triangles instead of
+ * storing them all.
+ *
+ * The triangles are written to the block buffer blk, which holds
+ * kblk triangles (kblk >= 2). Each time it fills up, the first
+ * kblk - 1 triangles are passed to sink(ctx, blk, kblk - 1) and
+ * the block starts again; the last ones are passed before
+ * returning. Memory use does not grow with the band length, and
+ * the sink (a file writer, a solver assembler, ...) works while
+ * the band is being zipped. A sink returning 0 stops the zipper.
+ *
+ * Return:
+ *   Number of triangles generated (na + nb - 2), or 0 if the
+ *   zipper fails or the sink stops it. The triangles already
+ *   passed to the sink are then only a part of the band.
+ */
+int fill_between_stream(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *blk, int kblk,
+    FillSink sink, void *ctx)
+{
+    return fill_zip_stream(x, y, ia, na, ib, nb, blk, kblk, sink, ctx);
+}
+
+/*
+ * Same as fill_between, for curves whose vertices are contiguous
+ * (or evenly spaced) in x, y: vertex k of the first curve is
+ * a0 + k*sa and vertex k of the second one is b0 + k*sb.
+ * The coordinates are read in sequence without going through
+ * index arrays.
+ */
+int fill_between_range(
+    double *x, double *y,
+    int a0, int sa, int na,
+    int b0, int sb, int nb,
+    int *tri)
+{
+    return fill_zip_range(x, y, a0, sa, na, b0, sb, nb, tri);
+}
+
+/*
+ * Single precision versions of fill_between and
+ * fill_between_range: float coordinates, with the orientation
+ * tests done in double on them (see FE_FLOAT in fill_engine.h),
+ * so they give the triangles fill_between gives on the same
+ * points stored as double.
+ */
+int fill_between_f(
+    float *x, float *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri)
+{
+    return fill_zip_f(x, y, ia, na, ib, nb, tri);
+}
+
+int fill_between_range_f(
+    float *x, float *y,
+    int a0, int sa, int na,
+    int b0, int sb, int nb,
+    int *tri)
+{
+    return fill_zip_range_f(x, y, a0, sa, na, b0, sb, nb, tri);
+}
+
+/*
+ * Same as fill_between, with the triangle adjacency built in
+ * the same pass (see FE_ADJ in fill_engine.h). The zipper knows
+ * the neighbours as it goes: each triangle shares an edge with
+ * the one before it, and its other edges are either shared with
+ * the next one or on a curve.
+ *
+ * Output:
+ *   tri   : integer array [3*(na+nb-2)] with vertex indices
+ *   nbr   : integer array [3*(na+nb-2)], nbr[3t+k] = 3s+l when
+ *           edge k of triangle t (from its vertex k to vertex
+ *           k+1) is edge l of triangle s, or -1 on the boundary
+ *   bnd   : integer array [na+nb], the boundary half-edges 3t+k:
+ *           bnd[i] on the segment ia[i], ia[i+1], bnd[na-1+j]
+ *           on the segment ib[j], ib[j+1], then the ends of the
+ *           band ia[0]-ib[0] and ia[na-1]-ib[nb-1]
+ *
+ * Return:
+ *   Number of triangles generated (na + nb - 2), or 0 as
+ *   fill_between
+ */
+int fill_between_adj(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int *nbr, int *bnd)
+{
+    return fill_zip_adj(x, y, ia, na, ib, nb, tri, nbr, bnd);
+}
+
+/* ===========================================================
+   Chunked parallel triangulation
+   =========================================================== */
+
+#define FILL_CHUNK 32768   // vertices per sub-band in fill_between_par
+#define ANCHOR_WINDOW 8    // search window for the anchors on ib
+
+/*
+ * Helper: cumulative arc length of a curve given by indices,
+ * normalized to [0,1]
+ */
+static void arc_fraction(double *x, double *y, int *ind, int n, double *s)
+{
+    s[0] = 0.0;
+    for (int k = 1; k < n; k++) {
+        double dx = x[ind[k]] - x[ind[k-1]], dy = y[ind[k]] - y[ind[k-1]];
+        s[k] = s[k-1] + sqrt(dx * dx + dy * dy);
+    }
+    double inv = s[n-1] > 0.0 ? 1.0 / s[n-1] : 0.0;
+    for (int k = 1; k < n; k++) s[k] *= inv;
+}
+
+/*
+ * Helper: first index k with s[k] >= f, clamped to [lo, n-1]
+ */
+static int arc_search(double *s, int n, int lo, double f)
+{
+    int hi = n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s[mid] < f) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Same as fill_between, for very long bands.
+ *
+ * The band is cut into nchunk sub-bands at anchor pairs
+ * (ia[i_k], ib[j_k]) taken at the same arc-length fraction
+ * k/nchunk along both curves, with j_k moved to the vertex of
+ * ib closest to ia[i_k] within ANCHOR_WINDOW positions. Each
+ * sub-band is zipped by fill_between on its own, concurrently
+ * with OpenMP. Sub-band k produces (na_k + nb_k - 2) triangles
+ * and consecutive sub-bands share their anchor vertices, so the
+ * sub-band offsets in tri are known in advance, the triangle
+ * order does not depend on the number of threads, and the total
+ * is still na + nb - 2.
+ *
+ * The anchors depend only on nchunk, so the same nchunk always
+ * gives the same triangles.
+ *
+ * fill_between_par_ws takes the anchor arrays from the arena of
+ * a workspace (see workspace.c) instead of malloc.
+ *
+ * Return:
+ *   Number of triangles generated, or 0 if any sub-band fails
+ */
+int fill_between_par_ws(
+    Grid2DWork *w,
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int nchunk)
+{
+    if (nchunk > (na < nb ? na : nb) - 1) nchunk = (na < nb ? na : nb) - 1;
+    if (nchunk <= 1) return fill_between(x, y, ia, na, ib, nb, tri);
+
+    grid2d_work_reset(w);
+    double *sa = grid2d_work_alloc(w, na * sizeof(double));
+    double *sb = grid2d_work_alloc(w, nb * sizeof(double));
+    int *ai = grid2d_work_alloc(w, (nchunk + 1) * sizeof(int));
+    int *bj = grid2d_work_alloc(w, (nchunk + 1) * sizeof(int));
+    int *toff = grid2d_work_alloc(w, (nchunk + 1) * sizeof(int));
+    if (!sa || !sb || !ai || !bj || !toff) return 0;
+
+    // Anchor pairs at equal arc-length fractions
+    arc_fraction(x, y, ia, na, sa);
+    arc_fraction(x, y, ib, nb, sb);
+    ai[0] = 0; bj[0] = 0;
+    ai[nchunk] = na - 1; bj[nchunk] = nb - 1;
+    for (int k = 1; k < nchunk; k++) {
+        double f = (double)k / nchunk;
+        ai[k] = arc_search(sa, na, ai[k-1], f);
+        bj[k] = arc_search(sb, nb, bj[k-1], f);
+
+        // Move the anchor on ib to the closest vertex of a small
+        // window, so that the anchor edge follows the band
+        int A = ia[ai[k]], j0 = bj[k] - ANCHOR_WINDOW, j1 = bj[k] + ANCHOR_WINDOW;
+        if (j0 < bj[k-1]) j0 = bj[k-1];
+        if (j1 > nb - 1) j1 = nb - 1;
+        double dmin = dist2(x[A], y[A], x[ib[bj[k]]], y[ib[bj[k]]]);
+        for (int j = j0; j <= j1; j++) {
+            double d = dist2(x[A], y[A], x[ib[j]], y[ib[j]]);
+            if (d < dmin) { dmin = d; bj[k] = j; }
+        }
     }
 
+    // Triangle offset of each sub-band
+    toff[0] = 0;
+    for (int k = 0; k < nchunk; k++)
+        toff[k+1] = toff[k] + (ai[k+1] - ai[k]) + (bj[k+1] - bj[k]);
+
+    // Zip the sub-bands concurrently
+    int fail = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(|:fail)
+    for (int k = 0; k < nchunk; k++) {
+        int expect = toff[k+1] - toff[k];
+        if (expect == 0) continue;
+        int r = fill_between(x, y,
+                             ia + ai[k], ai[k+1] - ai[k] + 1,
+                             ib + bj[k], bj[k+1] - bj[k] + 1,
+                             tri + 3 * toff[k]);
+        if (r != expect) fail = 1;
+    }
+    return fail ? 0 : toff[nchunk];
+}
+
+int fill_between_par(
+    double *x, double *y,
+    int *ia, int na,
+    int *ib, int nb,
+    int *tri, int nchunk)
+{
+    Grid2DWork w = GRID2D_WORK_INIT;
+    int nt = fill_between_par_ws(&w, x, y, ia, na, ib, nb, tri, nchunk);
+    grid2d_work_free(&w);
     return nt;
 }
+
+#ifndef GRID2D_NO_D
+
+/*
+ * Helper: if ind[0..n-1] is an arithmetic progression, store its
+ * stride in *s and return 1
+ */
+static int index_stride(const int *ind, int n, int *s)
+{
+    *s = n > 1 ? ind[1] - ind[0] : 1;
+    for (int k = 2; k < n; k++)
+        if (ind[k] - ind[k-1] != *s) return 0;
+    return 1;
+}
+
 /*
  * Wrapper for r94: _fill_between4
  *
@@ -130,7 +588,8 @@ int fill_between(
  * Checks performed:
  *   1. DRun flag: if false, return DCreaNulo() silently
  *   2. Argument types: ia, ib must be integers; x, y must be doubles
- *   3. Argument sizes: x and y must have the same length
+ *   3. Argument sizes: x and y must have the same length, and
+ *      the curves must make at least one triangle
  *   4. Memory management: all input D* are freed before returning
  */
 D *_fill_between4(D *ia, D *ib, D *x, D *y) {
@@ -156,8 +615,9 @@ D *_fill_between4(D *ia, D *ib, D *x, D *y) {
         return DCreaNulo();
     }
 
-    // Check that x and y have the same number of elements
-    if(x->n != y->n) {
+    // Check that x and y have the same number of elements and
+    // that there is at least one triangle
+    if(x->n != y->n || ia->n < 1 || ib->n < 1 || ia->n + ib->n < 3) {
         DError("fill_between : bad argument size");
         // Free all input arguments before returning
         DLibera(ia);
@@ -170,18 +630,26 @@ D *_fill_between4(D *ia, D *ib, D *x, D *y) {
     int na = ia->n;  // number of indices in first set
     int nb = ib->n;  // number of indices in second set
 
-    // Allocate output D* array to hold triangle indices
-    // Maximum possible size: 3*(na + nb + 2)
-    D *tri = DCreaInt(3*(na+nb+2));  
+    // Output holds exactly na + nb - 2 triangles, written in place
+    D *tri = DCreaInt(3*(na+nb-2));
 
-    // Call the original fill_between routine
-    int ntri = fill_between(
-        x->p.d,       // x coordinates
-        y->p.d,       // y coordinates
-        ia->p.i, na,  // first index set
-        ib->p.i, nb,  // second index set
-        tri->p.i      // output triangles
-    );
+    // Consecutive index ranges (the usual case) take the contiguous
+    // fast path; anything else the indexed zipper
+    int sa, sb, ntri;
+    if (index_stride(ia->p.i, na, &sa) && index_stride(ib->p.i, nb, &sb))
+        ntri = fill_between_range(
+            x->p.d, y->p.d,
+            ia->p.i[0], sa, na,
+            ib->p.i[0], sb, nb,
+            tri->p.i);
+    else
+        ntri = fill_between(
+            x->p.d,       // x coordinates
+            y->p.d,       // y coordinates
+            ia->p.i, na,  // first index set
+            ib->p.i, nb,  // second index set
+            tri->p.i      // output triangles
+        );
 
     // Free all input arguments
     DLibera(ia);
@@ -191,7 +659,7 @@ D *_fill_between4(D *ia, D *ib, D *x, D *y) {
 
     // Check if the routine generated triangles
     if(ntri <= 0) {
-        DLibera(tri);       // free output memory
+        DLibera(tri);
         return DCreaNulo(); // return null on failure
     }
 
@@ -201,3 +669,241 @@ D *_fill_between4(D *ia, D *ib, D *x, D *y) {
 
 
 
+
+/*
+ * Wrapper for fill_between_repair: _fill_between_repair4
+ *
+ * Same inputs and checks as _fill_between4.
+ *
+ * Output (D*):
+ *   list with
+ *     tri : integer array with the triangles (3 indices per triangle)
+ *     rep : integer array with the indices of the repaired triangles
+ *     bad : integer array with the indices of the triangles no
+ *           repair could fix (still inverted), empty if none
+ *   Returns DCreaNulo() on error
+ */
+D *_fill_between_repair4(D *ia, D *ib, D *x, D *y) {
+    // Check if previous error occurred (DRun is false)
+    if(!DRun) {
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if(ia->t != D_TIPO_INT || ib->t != D_TIPO_INT || x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE) {
+        DError("fill_between_repair : bad argument type");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check that x and y have the same number of elements
+    if(x->n != y->n || ia->n < 1 || ib->n < 1 || ia->n + ib->n < 3) {
+        DError("fill_between_repair : bad argument size");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    int na = ia->n;  // number of indices in first set
+    int nb = ib->n;  // number of indices in second set
+
+    // Output holds exactly na + nb - 2 triangles, and at most as
+    // many repaired and unfixed triangle indices
+    D *tri = DCreaInt(3*(na+nb-2));
+    D *rep = DCreaInt(na+nb-2);
+    int nrep = 0, nbad = 0;
+
+    int ntri = fill_between_repair(
+        x->p.d, y->p.d,
+        ia->p.i, na,
+        ib->p.i, nb,
+        tri->p.i, rep->p.i, &nrep, &nbad);
+
+    // Free all input arguments
+    DLibera(ia);
+    DLibera(ib);
+    DLibera(x);
+    DLibera(y);
+
+    // Check if the routine generated triangles
+    if(ntri <= 0) {
+        DLibera(tri);
+        DLibera(rep);
+        return DCreaNulo();
+    }
+
+    // The unfixed triangles follow the repaired ones in rep: move
+    // them to their own array and trim rep to the repaired ones
+    D *bad = DCreaInt(nbad > 0 ? nbad : 1);
+    memcpy(bad->p.i, rep->p.i + nrep, nbad * sizeof(int));
+    rep->n = nrep;
+    bad->n = nbad;
+
+    D *output = DCreaLista();
+    DInserta(output, tri);
+    DInserta(output, rep);
+    DInserta(output, bad);
+    return output;
+}
+
+
+
+
+/*
+ * Wrapper for fill_between_adj: _fill_between_adj4
+ *
+ * Same inputs and checks as _fill_between4.
+ *
+ * Output (D*):
+ *   list with
+ *     tri : integer array with the triangles (3 indices per triangle)
+ *     nbr : integer array with the neighbour half-edges (3 per triangle)
+ *     bnd : integer array with the boundary half-edges
+ *   Returns DCreaNulo() on error
+ */
+D *_fill_between_adj4(D *ia, D *ib, D *x, D *y) {
+    // Check if previous error occurred (DRun is false)
+    if(!DRun) {
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if(ia->t != D_TIPO_INT || ib->t != D_TIPO_INT || x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE) {
+        DError("fill_between_adj : bad argument type");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check that x and y have the same number of elements
+    if(x->n != y->n || ia->n < 1 || ib->n < 1 || ia->n + ib->n < 3) {
+        DError("fill_between_adj : bad argument size");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    int na = ia->n;  // number of indices in first set
+    int nb = ib->n;  // number of indices in second set
+
+    // Outputs of the exact sizes, written in place: na + nb - 2
+    // triangles, their neighbours and the na + nb boundary edges
+    D *tri = DCreaInt(3*(na+nb-2));
+    D *nbr = DCreaInt(3*(na+nb-2));
+    D *bnd = DCreaInt(na + nb);
+
+    int ntri = fill_between_adj(
+        x->p.d, y->p.d,
+        ia->p.i, na,
+        ib->p.i, nb,
+        tri->p.i, nbr->p.i, bnd->p.i);
+
+    // Free all input arguments
+    DLibera(ia);
+    DLibera(ib);
+    DLibera(x);
+    DLibera(y);
+
+    // Check if the routine generated triangles
+    if(ntri <= 0) {
+        DLibera(tri);
+        DLibera(nbr);
+        DLibera(bnd);
+        return DCreaNulo();
+    }
+
+    D *output = DCreaLista();
+    DInserta(output, tri);
+    DInserta(output, nbr);
+    DInserta(output, bnd);
+    return output;
+}
+
+
+
+
+/*
+ * Wrapper for fill_between_par: _fill_between_par4
+ *
+ * Same inputs, outputs and checks as _fill_between4. The band is
+ * cut into one sub-band per FILL_CHUNK vertices, so the result
+ * does not depend on the number of threads.
+ */
+D *_fill_between_par4(D *ia, D *ib, D *x, D *y) {
+    // Check if previous error occurred (DRun is false)
+    if(!DRun) {
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check argument types
+    if(ia->t != D_TIPO_INT || ib->t != D_TIPO_INT || x->t != D_TIPO_DOUBLE || y->t != D_TIPO_DOUBLE) {
+        DError("fill_between_par : bad argument type");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    // Check that x and y have the same number of elements
+    if(x->n != y->n || ia->n < 1 || ib->n < 1 || ia->n + ib->n < 3) {
+        DError("fill_between_par : bad argument size");
+        DLibera(ia);
+        DLibera(ib);
+        DLibera(x);
+        DLibera(y);
+        return DCreaNulo();
+    }
+
+    int na = ia->n;  // number of indices in first set
+    int nb = ib->n;  // number of indices in second set
+
+    // Output holds exactly na + nb - 2 triangles, written in place;
+    // the anchors come from the arena of the shared workspace
+    D *tri = DCreaInt(3*(na+nb-2));
+
+    int ntri = fill_between_par_ws(
+        grid2d_d_work(),
+        x->p.d, y->p.d,
+        ia->p.i, na,
+        ib->p.i, nb,
+        tri->p.i,
+        (na + nb) / FILL_CHUNK);
+
+    // Free all input arguments
+    DLibera(ia);
+    DLibera(ib);
+    DLibera(x);
+    DLibera(y);
+
+    // Check if the routine generated triangles
+    if(ntri <= 0) {
+        DLibera(tri);
+        return DCreaNulo();
+    }
+
+    return tri;
+}
+
+#endif
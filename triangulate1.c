@@ -1,15 +1,17 @@
 #include <stdio.h>
 #include <math.h>
+#include "predicates.h"
 
 /* ===========================================================
    Helper functions
    =========================================================== */
 
 // Compute oriented area (twice the triangle area, signed)
-// Positive if counterclockwise (CCW)
+// Positive if counterclockwise (CCW). The sign is exact even for
+// nearly collinear points (filtered predicate, see predicates.h)
 static double area(double xa, double ya, double xb, double yb, double xc, double yc)
 {
-    return (xb - xa) * (yc - ya) - (yb - ya) * (xc - xa);
+    return orient2d(xa, ya, xb, yb, xc, yc);
 }
 
 // Squared distance between two points (no sqrt needed)
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "grid2d.h"
+
+/*-------------------------------------------------------------
+  Reusable workspace
+  -------------------------------------------------------------
+  A Grid2DWork holds everything the kernels would otherwise
+  allocate on every call, so that a remeshing loop calling them
+  thousands of times allocates nothing once it has warmed up:
+
+  - An arena for the scratch arrays of one call (grid buckets of
+    remove_self_intersections, anchors of fill_between_par, ...).
+    Memory is taken from the current block by moving a pointer;
+    when it does not fit, a new, larger block is chained. Each
+    _ws routine resets the arena when it starts, and a reset
+    after a call that needed several blocks merges them into one
+    block of their total size. From then on, calls of the same
+    size fit in that block and make no malloc at all.
+  - The output buffers of the offset curve (x0, y0) and of the
+    triangles (tri), which are kept between calls and only grow
+    when a call needs more room.
+
+  Scratch memory is only valid during the call that took it; the
+  output buffers stay valid until the next call that uses them.
+
+  A workspace starts as GRID2D_WORK_INIT and is released with
+  grid2d_work_free. It must not be shared by concurrent calls.
+-------------------------------------------------------------*/
+
+#define WORK_ALIGN  16            // alignment of every arena allocation
+#define WORK_BLOCK  (64 * 1024)   // size of the first arena block
+
+struct Grid2DBlock {
+    struct Grid2DBlock *next;     // older block
+    size_t cap, top;              // capacity and used bytes of the data
+};
+
+/* Data of a block, after the header rounded up to WORK_ALIGN */
+#define BLOCK_HEADER  ((sizeof(Grid2DBlock) + WORK_ALIGN - 1) & ~(size_t)(WORK_ALIGN - 1))
+#define BLOCK_DATA(b) ((char *)(b) + BLOCK_HEADER)
+
+static Grid2DBlock *new_block(size_t cap, Grid2DBlock *next) {
+    Grid2DBlock *b = malloc(BLOCK_HEADER + cap);
+    if (!b) return NULL;
+    b->next = next;
+    b->cap = cap;
+    b->top = 0;
+    return b;
+}
+
+/*-------------------------------------------------------------
+  Take bytes of scratch memory from the arena
+  Returns NULL if out of memory
+-------------------------------------------------------------*/
+void *grid2d_work_alloc(Grid2DWork *w, size_t bytes) {
+    Grid2DBlock *b = w->arena;
+    bytes = (bytes + WORK_ALIGN - 1) & ~(size_t)(WORK_ALIGN - 1);
+    if (!b || b->top + bytes > b->cap) {
+        size_t cap = b ? 2 * b->cap : WORK_BLOCK;
+        if (cap < bytes) cap = bytes;
+        b = new_block(cap, w->arena);
+        if (!b) return NULL;
+        w->arena = b;
+    }
+    void *p = BLOCK_DATA(b) + b->top;
+    b->top += bytes;
+    return p;
+}
+
+/*-------------------------------------------------------------
+  Release all the scratch memory taken since the last reset
+-------------------------------------------------------------*/
+void grid2d_work_reset(Grid2DWork *w) {
+    Grid2DBlock *b = w->arena;
+    if (!b) return;
+    if (b->next) {
+        /* Several blocks: replace them by one with room for all */
+        size_t cap = 0;
+        while (b) {
+            Grid2DBlock *next = b->next;
+            cap += b->cap;
+            free(b);
+            b = next;
+        }
+        w->arena = new_block(cap, NULL);
+    } else {
+        b->top = 0;
+    }
+}
+
+/*-------------------------------------------------------------
+  Make room for n points in the offset output buffers
+  Returns 0 if out of memory
+-------------------------------------------------------------*/
+int grid2d_work_reserve_xy(Grid2DWork *w, int n) {
+    if (n <= w->nxy) return 1;
+    int cap = w->nxy > 0 ? w->nxy : 256;
+    while (cap < n) cap *= 2;
+    free(w->x0);
+    free(w->y0);
+    w->x0 = malloc(cap * sizeof(double));
+    w->y0 = malloc(cap * sizeof(double));
+    if (!w->x0 || !w->y0) {
+        free(w->x0); free(w->y0);
+        w->x0 = w->y0 = NULL;
+        w->nxy = 0;
+        return 0;
+    }
+    w->nxy = cap;
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Make room for nt triangles in the triangle output buffer
+  Returns 0 if out of memory
+-------------------------------------------------------------*/
+int grid2d_work_reserve_tri(Grid2DWork *w, int nt) {
+    if (nt <= w->ntri) return 1;
+    int cap = w->ntri > 0 ? w->ntri : 256;
+    while (cap < nt) cap *= 2;
+    free(w->tri);
+    w->tri = malloc(3 * (size_t)cap * sizeof(int));
+    if (!w->tri) {
+        w->ntri = 0;
+        return 0;
+    }
+    w->ntri = cap;
+    return 1;
+}
+
+/*-------------------------------------------------------------
+  Free all the memory of a workspace and leave it empty
+-------------------------------------------------------------*/
+void grid2d_work_free(Grid2DWork *w) {
+    Grid2DBlock *b = w->arena;
+    while (b) {
+        Grid2DBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    free(w->x0);
+    free(w->y0);
+    free(w->tri);
+    *w = (Grid2DWork)GRID2D_WORK_INIT;
+}
+
+/*-------------------------------------------------------------
+  Workspace shared by the D wrappers of all the modules
+  (one per thread, kept for the life of the program)
+-------------------------------------------------------------*/
+Grid2DWork *grid2d_d_work(void) {
+    static _Thread_local Grid2DWork w = GRID2D_WORK_INIT;
+    return &w;
+}